@@ -0,0 +1,219 @@
+#include "ADMMQPSolver.h"
+#include <algorithm>
+#include <cmath>
+
+using Eigen::VectorXd;
+
+void ADMMQPSolver::Prepare(const MPCQP &qp) {
+  const MPCLayout &layout = qp.layout;
+  const size_t N = layout.N;
+  n_ = layout.n_vars;
+  m_eq_ = layout.n_constraints;
+  m_ = m_eq_ + n_;
+
+  // C = [E; I]. All entries of A and B are inserted, zero or not, so the
+  // pattern of C and the KKT matrix does not change between frames.
+  std::vector<Eigen::Triplet<double> > triplets;
+  triplets.reserve(m_eq_ * 9 + n_);
+  for (size_t k = 0; k < 6; ++k) {
+    size_t row = layout.StateStart(k);
+    triplets.push_back(Eigen::Triplet<double>(row, row, 1.0));
+  }
+  for (size_t t = 1; t < N; ++t) {
+    for (size_t k = 0; k < 6; ++k) {
+      size_t row = layout.StateStart(k) + t;
+      triplets.push_back(Eigen::Triplet<double>(row, row, 1.0));
+      for (size_t j = 0; j < 6; ++j) {
+        triplets.push_back(Eigen::Triplet<double>(
+            row, layout.StateStart(j) + t - 1, -qp.A[t - 1](k, j)));
+      }
+      size_t m = layout.Move(t - 1);
+      triplets.push_back(Eigen::Triplet<double>(
+          row, layout.delta_start + m, -qp.B[t - 1](k, 0)));
+      triplets.push_back(Eigen::Triplet<double>(row, layout.a_start + m,
+                                                -qp.B[t - 1](k, 1)));
+    }
+  }
+  for (size_t i = 0; i < n_; ++i) {
+    triplets.push_back(Eigen::Triplet<double>(m_eq_ + i, i, 1.0));
+  }
+  C_.resize(m_, n_);
+  C_.setFromTriplets(triplets.begin(), triplets.end());
+
+  if (P_.rows() != static_cast<int>(n_)) {
+    // The cost is constant, so P and its scaling are set up once.
+    P_ = qp.H.sparseView();
+    Scale();
+    y_warm_.setZero(m_);
+    has_dual_ = false;
+    analyzed_ = false;
+  } else if (has_dual_) {
+    ShiftDual(layout);
+  }
+  Factorize();
+}
+
+// Scale the cost so the mean column norm of P is one. The constraints are
+// left unscaled, Ruiz equilibration of the KKT matrix made convergence
+// slower on this problem.
+void ADMMQPSolver::Scale() {
+  double mean_norm = 0.0;
+  for (int j = 0; j < P_.outerSize(); ++j) {
+    double norm = 0.0;
+    for (SparseMatrix::InnerIterator it(P_, j); it; ++it) {
+      norm = std::max(norm, std::abs(it.value()));
+    }
+    mean_norm += norm;
+  }
+  mean_norm /= n_;
+  cost_scale_ = mean_norm < 1.0e-4 ? 1.0 : 1.0 / mean_norm;
+  P_s_ = cost_scale_ * P_;
+}
+
+void ADMMQPSolver::Factorize() {
+  rho_vec_.resize(m_);
+  rho_vec_.head(m_eq_).setConstant(rho * eq_rho_scale);
+  rho_vec_.tail(n_).setConstant(rho);
+
+  std::vector<Eigen::Triplet<double> > triplets;
+  triplets.reserve(P_s_.nonZeros() + 2 * C_.nonZeros() + n_ + m_);
+  for (int j = 0; j < P_s_.outerSize(); ++j) {
+    for (SparseMatrix::InnerIterator it(P_s_, j); it; ++it) {
+      triplets.push_back(Eigen::Triplet<double>(it.row(), it.col(),
+                                                it.value()));
+    }
+  }
+  for (size_t i = 0; i < n_; ++i) {
+    triplets.push_back(Eigen::Triplet<double>(i, i, sigma));
+  }
+  for (int j = 0; j < C_.outerSize(); ++j) {
+    for (SparseMatrix::InnerIterator it(C_, j); it; ++it) {
+      triplets.push_back(Eigen::Triplet<double>(n_ + it.row(), it.col(),
+                                                it.value()));
+      triplets.push_back(Eigen::Triplet<double>(it.col(), n_ + it.row(),
+                                                it.value()));
+    }
+  }
+  for (size_t i = 0; i < m_; ++i) {
+    triplets.push_back(Eigen::Triplet<double>(n_ + i, n_ + i,
+                                              -1.0 / rho_vec_[i]));
+  }
+  kkt_.resize(n_ + m_, n_ + m_);
+  kkt_.setFromTriplets(triplets.begin(), triplets.end());
+
+  if (!analyzed_) {
+    ldlt_.analyzePattern(kkt_);
+    analyzed_ = true;
+  }
+  ldlt_.factorize(kkt_);
+  factor_rho_ = rho;
+}
+
+// Shift the duals one step forward, like the primal trajectory.
+void ADMMQPSolver::ShiftDual(const MPCLayout &layout) {
+  const size_t N = layout.N;
+  for (size_t k = 0; k < 6; ++k) {
+    ShiftBlock(y_warm_.data(), layout.StateStart(k), N);
+    ShiftBlock(y_warm_.data(), m_eq_ + layout.StateStart(k), N);
+  }
+  ShiftMovesT(layout, y_warm_.data() + m_eq_ + layout.delta_start);
+  ShiftMovesT(layout, y_warm_.data() + m_eq_ + layout.a_start);
+}
+
+bool ADMMQPSolver::Solve(const MPCQP &qp, VectorXd &z) {
+  const MPCLayout &layout = qp.layout;
+  const size_t N = layout.N;
+  if (rho != factor_rho_) {
+    Factorize();
+  }
+
+  // l <= C z <= u: dynamics as equalities, then the variable bounds.
+  l_.resize(m_);
+  for (size_t k = 0; k < 6; ++k) {
+    l_[layout.StateStart(k)] = qp.x0[k];
+  }
+  for (size_t t = 1; t < N; ++t) {
+    for (size_t k = 0; k < 6; ++k) {
+      l_[layout.StateStart(k) + t] = qp.c[t - 1][k];
+    }
+  }
+  u_ = l_;
+  for (size_t i = 0; i < n_; ++i) {
+    l_[m_eq_ + i] = HasBound(qp.lb[i]) ? qp.lb[i] : -INFINITY;
+    u_[m_eq_ + i] = HasBound(qp.ub[i]) ? qp.ub[i] : INFINITY;
+  }
+  q_ = cost_scale_ * qp.q;
+
+  x_ = z;
+  zc_ = (C_ * x_).cwiseMax(l_).cwiseMin(u_);
+  if (has_dual_) {
+    y_ = cost_scale_ * y_warm_;
+  } else {
+    y_.setZero(m_);
+  }
+
+  bool converged = false;
+  deadline_hit_ = false;
+  rhs_.resize(n_ + m_);
+  for (last_iterations_ = 0; last_iterations_ < max_iterations;) {
+    ++last_iterations_;
+    rhs_.head(n_) = sigma * x_ - q_;
+    rhs_.tail(m_) = zc_ - y_.cwiseQuotient(rho_vec_);
+    sol_ = ldlt_.solve(rhs_);
+    x_tilde_ = sol_.head(n_);
+    z_tilde_ = zc_ + (sol_.tail(m_) - y_).cwiseQuotient(rho_vec_);
+
+    x_ = alpha * x_tilde_ + (1.0 - alpha) * x_;
+    z_prev_ = alpha * z_tilde_ + (1.0 - alpha) * zc_;
+    zc_ = (z_prev_ + y_.cwiseQuotient(rho_vec_)).cwiseMax(l_).cwiseMin(u_);
+    y_ += rho_vec_.cwiseProduct(z_prev_ - zc_);
+
+    if (last_iterations_ % 5 == 0) {
+      // Residuals of the unscaled problem.
+      VectorXd Cx = C_ * x_;
+      const VectorXd &zc = zc_;
+      VectorXd Px = P_ * x_;
+      VectorXd Cty = C_.transpose() * y_ / cost_scale_;
+      double prim_norm = std::max(Cx.lpNorm<Eigen::Infinity>(),
+                                  zc.lpNorm<Eigen::Infinity>());
+      double dual_norm = std::max(std::max(Px.lpNorm<Eigen::Infinity>(),
+                                           Cty.lpNorm<Eigen::Infinity>()),
+                                  qp.q.lpNorm<Eigen::Infinity>());
+      double prim_res = (Cx - zc).lpNorm<Eigen::Infinity>();
+      double dual_res = (Px + qp.q + Cty).lpNorm<Eigen::Infinity>();
+      if (prim_res <= eps_abs + eps_rel * prim_norm &&
+          dual_res <= eps_abs + eps_rel * dual_norm) {
+        converged = true;
+        break;
+      }
+      // The iterate is made feasible below, so stopping early still gives
+      // a plan.
+      if (deadline.Near(deadline_reserve_ms)) {
+        deadline_hit_ = true;
+        break;
+      }
+
+      // Balance the residuals; refactor only for a significant change.
+      if (adaptive_rho && last_iterations_ % 25 == 0) {
+        double ratio = (prim_res / (prim_norm + 1.0e-10)) /
+                       (dual_res / (dual_norm + 1.0e-10) + 1.0e-10);
+        double new_rho = std::min(std::max(rho * std::sqrt(ratio), 1.0e-6),
+                                  1.0e6);
+        if (new_rho > 5.0 * rho || new_rho < 0.2 * rho) {
+          rho = new_rho;
+          Factorize();
+        }
+      }
+    }
+  }
+  has_dual_ = y_.allFinite();
+  if (has_dual_) {
+    y_warm_ = y_ / cost_scale_;
+  }
+
+  // Make the result exactly feasible: actuations clipped to their bounds,
+  // states from the linear dynamics.
+  z = x_.cwiseMax(qp.lb).cwiseMin(qp.ub);
+  qp.Rollout(z.data());
+  return converged;
+}
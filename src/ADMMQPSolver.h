@@ -0,0 +1,83 @@
+#ifndef ADMM_QP_SOLVER_H
+#define ADMM_QP_SOLVER_H
+
+#include <vector>
+#include "Eigen-3.3/Eigen/Core"
+#include "Eigen-3.3/Eigen/SparseCholesky"
+#include "Eigen-3.3/Eigen/SparseCore"
+#include "MPCQP.h"
+
+//
+// Operator splitting (ADMM, as in OSQP) solver of MPCQP on the sparse,
+// block banded structure of the uncondensed problem.
+//
+// The QP is written as
+//
+//   min 0.5 z'Hz + q'z   s.t.   l <= C z <= u,   C = [E; I],
+//
+// with E z = e the dynamics and the identity rows the variable bounds.
+// Every iteration solves one quasi-definite KKT system
+//
+//   [c H + sigma I   C'          ]
+//   [C               -diag(1/rho)]
+//
+// with a SimplicialLDLT factorization, c scaling the cost to unit size.
+// The sparsity pattern is fixed by the layout, so it is analyzed once; the
+// numeric factorization is redone in Prepare() for new Jacobians, and in
+// Solve() only if rho changes (set by the caller, or adapted to the ratio
+// of primal and dual residuals when adaptive_rho is set). Primal and dual
+// iterates are kept between solves and shifted one step forward as warm
+// start.
+//
+class ADMMQPSolver : public MPCQPSolver {
+ public:
+  // Step size of the equality rows is rho times eq_rho_scale.
+  double rho = 0.1;
+  double eq_rho_scale = 1.0e3;
+  double sigma = 1.0e-6;
+  double alpha = 1.6;
+  double eps_abs = 1.0e-5;
+  double eps_rel = 1.0e-5;
+  int max_iterations = 4000;
+  bool adaptive_rho = true;
+
+  void Prepare(const MPCQP &qp) override;
+  bool Solve(const MPCQP &qp, Eigen::VectorXd &z) override;
+
+ private:
+  typedef Eigen::SparseMatrix<double> SparseMatrix;
+
+  void Scale();
+  void Factorize();
+  void ShiftDual(const MPCLayout &layout);
+
+  size_t n_ = 0;
+  size_t m_eq_ = 0;
+  size_t m_ = 0;
+
+  // Constraints, cost and scaled cost P_s = cost_scale * P.
+  SparseMatrix C_;
+  SparseMatrix P_;
+  SparseMatrix P_s_;
+  double cost_scale_ = 1.0;
+  SparseMatrix kkt_;
+  Eigen::SimplicialLDLT<SparseMatrix> ldlt_;
+  bool analyzed_ = false;
+  double factor_rho_ = 0.0;
+
+  // Step sizes per constraint row.
+  Eigen::VectorXd rho_vec_;
+
+  // Constraint bounds, scaled linear cost and iterates (x is the z of
+  // MPCQP, zc = C x), and the unscaled dual kept for the next solve.
+  Eigen::VectorXd q_, l_, u_;
+  Eigen::VectorXd x_, zc_, y_;
+  Eigen::VectorXd y_warm_;
+  bool has_dual_ = false;
+
+  Eigen::VectorXd rhs_;
+  Eigen::VectorXd sol_;
+  Eigen::VectorXd x_tilde_, z_tilde_, z_prev_;
+};
+
+#endif  // ADMM_QP_SOLVER_H
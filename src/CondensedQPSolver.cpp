@@ -0,0 +1,116 @@
+#include "CondensedQPSolver.h"
+
+using Eigen::MatrixXd;
+using Eigen::VectorXd;
+
+void CondensedQPSolver::Prepare(const MPCQP &qp) {
+  const MPCLayout &layout = qp.layout;
+  const size_t N = layout.N;
+  const size_t ns = layout.delta_start;
+  const size_t nu = layout.n_vars - ns;
+
+  // Column j of M: response of all states to a unit actuation j, which
+  // enters through B at its step(s) and is propagated by A afterwards.
+  M_.setZero(ns, nu);
+  for (size_t tau = 0; tau + 1 < N; ++tau) {
+    for (size_t i = 0; i < 2; ++i) {
+      size_t col = i * layout.n_moves + layout.Move(tau);
+      Vector6d v = qp.B[tau].col(i);
+      for (size_t t = tau + 1; t < N; ++t) {
+        for (size_t k = 0; k < 6; ++k) {
+          M_(layout.StateStart(k) + t, col) += v[k];
+        }
+        if (t + 1 < N) {
+          v = qp.A[t] * v;
+        }
+      }
+    }
+  }
+
+  MatrixXd Hsu = qp.H.topRightCorner(ns, nu);
+  Gs_ = M_.transpose() * qp.H.topLeftCorner(ns, ns) + Hsu.transpose();
+  Hc_ = Gs_ * M_ + M_.transpose() * Hsu + qp.H.bottomRightCorner(nu, nu);
+  g0_ = M_.transpose() * qp.q.head(ns) + qp.q.tail(nu);
+
+  // Warm start from the previous working set, shifted like the actuations.
+  if (fixed_.size() != nu) {
+    fixed_.assign(nu, 0);
+  } else {
+    for (size_t i = 0; i < 2; ++i) {
+      ShiftMovesT(layout, &fixed_[i * layout.n_moves]);
+    }
+  }
+}
+
+bool CondensedQPSolver::Solve(const MPCQP &qp, VectorXd &z) {
+  const MPCLayout &layout = qp.layout;
+  const size_t ns = layout.delta_start;
+  const size_t nu = layout.n_vars - ns;
+
+  // Gradient of the condensed cost for the current x0 and c.
+  z_free_ = z;
+  z_free_.tail(nu).setZero();
+  qp.Rollout(z_free_.data());
+  g_ = Gs_ * z_free_.head(ns) + g0_;
+
+  // Feasible start: the previous working set at its bounds, the remaining
+  // actuations clipped.
+  lb_ = qp.lb.tail(nu);
+  ub_ = qp.ub.tail(nu);
+  u_ = z.tail(nu).cwiseMax(lb_).cwiseMin(ub_);
+  for (size_t i = 0; i < nu; ++i) {
+    if (lb_[i] == ub_[i]) {
+      fixed_[i] = -1;
+    } else if (fixed_[i] < 0 && !HasBound(lb_[i])) {
+      fixed_[i] = 0;
+    } else if (fixed_[i] > 0 && !HasBound(ub_[i])) {
+      fixed_[i] = 0;
+    }
+    if (fixed_[i] < 0) {
+      u_[i] = lb_[i];
+    } else if (fixed_[i] > 0) {
+      u_[i] = ub_[i];
+    }
+  }
+
+  bool converged = Iterate(qp, lb_, ub_, u_);
+  z.tail(nu) = u_;
+  qp.Rollout(z.data());
+  return converged;
+}
+
+void CondensedQPSolver::MinimizeFree(const MPCQP &qp, const VectorXd &u,
+                                     VectorXd &candidate) {
+  const size_t nu = u.size();
+  const size_t nf = free_.size();
+  if (nf == 0) {
+    return;
+  }
+
+  // Minimize over the free actuations:
+  //   Hc_FF u_F = -(g_F + Hc_FW u_W).
+  H_free_.resize(nf, nf);
+  rhs_.resize(nf);
+  for (size_t a = 0; a < nf; ++a) {
+    double r = -g_[free_[a]];
+    for (size_t j = 0; j < nu; ++j) {
+      if (fixed_[j] != 0) {
+        r -= Hc_(free_[a], j) * u[j];
+      }
+    }
+    rhs_[a] = r;
+    for (size_t b = 0; b < nf; ++b) {
+      H_free_(a, b) = Hc_(free_[a], free_[b]);
+    }
+  }
+  llt_.compute(H_free_);
+  rhs_ = llt_.solve(rhs_);
+  for (size_t a = 0; a < nf; ++a) {
+    candidate[free_[a]] = rhs_[a];
+  }
+}
+
+void CondensedQPSolver::Gradient(const MPCQP &qp, const VectorXd &u,
+                                 VectorXd &r) {
+  r = Hc_ * u + g_;
+}
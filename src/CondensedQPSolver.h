@@ -0,0 +1,54 @@
+#ifndef CONDENSED_QP_SOLVER_H
+#define CONDENSED_QP_SOLVER_H
+
+#include <vector>
+#include "Eigen-3.3/Eigen/Cholesky"
+#include "Eigen-3.3/Eigen/Core"
+#include "MPCQP.h"
+
+//
+// Condensed solver of MPCQP.
+//
+// Prepare() eliminates the states with the linearized dynamics,
+//
+//   s = s_free + M u,
+//
+// where u = (delta_0..delta_{N-2}, a_0..a_{N-2}) and s_free is the state
+// trajectory for u = 0, which leaves a dense QP over the 2(N-1) actuations
+// (the moves with move blocking) with box constraints only:
+//
+//   min 0.5 u'Hc u + g'u   s.t.   lb_u <= u <= ub_u.
+//
+// Hc does not depend on x0 or c, so Solve() only computes s_free and g and
+// runs a primal active-set method, each iteration a Cholesky (LLT) solve on
+// the free actuations. The working set is kept between solves and shifted
+// one step forward in Prepare(), like the RTI trajectory.
+//
+class CondensedQPSolver : public BoxActiveSetSolver {
+ public:
+  void Prepare(const MPCQP &qp) override;
+  bool Solve(const MPCQP &qp, Eigen::VectorXd &z) override;
+
+ private:
+  void MinimizeFree(const MPCQP &qp, const Eigen::VectorXd &u,
+                    Eigen::VectorXd &candidate) override;
+  void Gradient(const MPCQP &qp, const Eigen::VectorXd &u,
+                Eigen::VectorXd &r) override;
+
+  // s = s_free + M u, with rows in the state order of MPCLayout.
+  Eigen::MatrixXd M_;
+  Eigen::MatrixXd Hc_;
+  // g = Gs * s_free + g0.
+  Eigen::MatrixXd Gs_;
+  Eigen::VectorXd g0_;
+
+  Eigen::VectorXd z_free_;
+  Eigen::VectorXd g_;
+  Eigen::VectorXd u_;
+  Eigen::VectorXd lb_, ub_;
+  Eigen::MatrixXd H_free_;
+  Eigen::VectorXd rhs_;
+  Eigen::LLT<Eigen::MatrixXd> llt_;
+};
+
+#endif  // CONDENSED_QP_SOLVER_H
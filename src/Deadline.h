@@ -0,0 +1,40 @@
+#ifndef DEADLINE_H
+#define DEADLINE_H
+
+#include <chrono>
+
+//
+// Wall-clock deadline of a solve. Default constructed it is unset, i.e.
+// never reached.
+//
+class Deadline {
+ public:
+  typedef std::chrono::steady_clock Clock;
+
+  Deadline() : at_(Clock::time_point::max()) {}
+  explicit Deadline(Clock::time_point at) : at_(at) {}
+
+  // Deadline `ms` milliseconds after `start`.
+  static Deadline After(Clock::time_point start, double ms) {
+    return Deadline(start + std::chrono::duration_cast<Clock::duration>(
+                                std::chrono::duration<double, std::milli>(ms)));
+  }
+
+  bool IsSet() const { return at_ != Clock::time_point::max(); }
+  Clock::time_point At() const { return at_; }
+
+  // True if less than `reserve_ms` milliseconds are left.
+  bool Near(double reserve_ms = 0.0) const {
+    return IsSet() && RemainingMs() <= reserve_ms;
+  }
+
+  double RemainingMs() const {
+    return std::chrono::duration<double, std::milli>(at_ - Clock::now())
+        .count();
+  }
+
+ private:
+  Clock::time_point at_;
+};
+
+#endif  // DEADLINE_H
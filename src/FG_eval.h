@@ -0,0 +1,177 @@
+#ifndef FG_EVAL_H
+#define FG_EVAL_H
+
+#include <cppad/cppad.hpp>
+#include "Eigen-3.3/Eigen/Core"
+#include "MPCProblem.h"
+
+using CppAD::AD;
+
+//
+// Cost and constraints of the MPC NLP as CppAD functions, for any layout in
+// MPCProblem.h.
+//
+template <class Layout>
+class FG_evalT {
+ public:
+  typedef CPPAD_TESTVECTOR(AD<double>) ADvector;
+
+  Layout layout;
+
+  // Fitted polynomial coefficients. Constants when solving through
+  // CppAD::ipopt::solve, independent tape parameters for MPCTape.
+  ADvector coeffs;
+  FG_evalT(const Layout &layout, const Eigen::VectorXd &coeffs)
+      : layout(layout) {
+    this->coeffs.resize(coeffs.size());
+    for (int i = 0; i < coeffs.size(); ++i) {
+      this->coeffs[i] = coeffs[i];
+    }
+  }
+  explicit FG_evalT(const Layout &layout) : layout(layout) {}
+
+  // Evaluate with the given coefficients, e.g. tape parameters of MPCTape.
+  void operator()(ADvector& fg, const ADvector& vars, const ADvector& coeffs) {
+    this->coeffs.resize(coeffs.size());
+    for (size_t i = 0; i < coeffs.size(); ++i) {
+      this->coeffs[i] = coeffs[i];
+    }
+    (*this)(fg, vars);
+  }
+
+  void operator()(ADvector& fg, const ADvector& vars) {
+    /**
+     * DONE: implement MPC
+     * `fg` is a vector of the cost constraints, `vars` is a vector of variable 
+     *   values (state & actuators)
+     * NOTE: You'll probably go back and forth between this function and
+     *   the Solver function below.
+     */
+
+    fg[0] = 0; // start with zero cost
+#define USE_MPC_QUIZ_INSTEAD_OF_VIDEO_WALKTHROUGH
+#undef USE_MPC_QUIZ_INSTEAD_OF_VIDEO_WALKTHROUGH
+    // Reference State Cost
+    /**
+     * DONE: Define the cost related the reference state and
+     *   anything you think may be beneficial.
+     */
+    // part of the cost based on reference state
+    for(size_t t=0; t<layout.N; ++t)
+    {
+#ifdef USE_MPC_QUIZ_INSTEAD_OF_VIDEO_WALKTHROUGH
+      fg[0] += CppAD::pow(vars[layout.cte_start + t], 2);       // minimize Cross Track Error for every time step
+      fg[0] += CppAD::pow(vars[layout.epsi_start + t], 2);      // minimize orientation error for every time step
+      fg[0] += CppAD::pow(vars[layout.v_start + t] - ref_v, 2); // minimize deviation to reference speed
+#else // video walkthrough, different weighting
+      // minimize Cross Track Error, orientation error and deviation to
+      // reference speed for every time step, see StateCostT()
+      fg[0] += StateCostT(vars[layout.v_start + t], vars[layout.cte_start + t],
+                          vars[layout.epsi_start + t]);
+#endif
+    }
+    // minimize use of actuators
+    for(size_t t=0; t<layout.N-1; ++t)
+    {
+      // actuations of the move of step t, see MPCLayout
+      const size_t m = layout.Move(t);
+#ifdef USE_MPC_QUIZ_INSTEAD_OF_VIDEO_WALKTHROUGH
+      fg[0] += CppAD::pow(vars[layout.delta_start + m], 2); // minimize use of steering
+      fg[0] += CppAD::pow(vars[layout.a_start + m], 2);     // minimize use of acceleration
+#else // video walkthrough, different weighting
+      // minimize use of steering and acceleration, see ActuationCostT()
+      fg[0] += ActuationCostT(vars[layout.delta_start + m], vars[layout.a_start + m]);
+#endif
+    }
+    // minimize value gap between sequential actuations
+    for(size_t t=0; t<layout.N-2; ++t)
+    {
+      // no gap inside a block of move blocking
+      const size_t m0 = layout.Move(t);
+      const size_t m1 = layout.Move(t + 1);
+      if (m1 == m0) {
+        continue;
+      }
+#ifdef USE_MPC_QUIZ_INSTEAD_OF_VIDEO_WALKTHROUGH
+      fg[0] += CppAD::pow(vars[layout.delta_start + m1] - vars[layout.delta_start + m0], 2); // minimize sequential steering gaps
+      fg[0] += CppAD::pow(vars[layout.a_start + m1] - vars[layout.a_start + m0], 2);         // minimize sequential acceleration gaps
+#else // video walkthrough, different weighting
+      // minimize sequential steering and acceleration gaps, see RateCostT()
+      fg[0] += RateCostT(vars[layout.delta_start + m1] - vars[layout.delta_start + m0],
+                         vars[layout.a_start + m1] - vars[layout.a_start + m0]);
+#endif
+    }
+
+    //
+    // Setup Constraints
+    //
+    // NOTE: In this section you'll setup the model constraints.
+
+    // Initial constraints
+    //
+    // We add 1 to each of the starting indices due to cost being located at
+    // index 0 of `fg`.
+    // This bumps up the position of all the other values.
+    fg[1 + layout.x_start]    = vars[layout.x_start];
+    fg[1 + layout.y_start]    = vars[layout.y_start];
+    fg[1 + layout.psi_start]  = vars[layout.psi_start];
+    fg[1 + layout.v_start]    = vars[layout.v_start];
+    fg[1 + layout.cte_start]  = vars[layout.cte_start];
+    fg[1 + layout.epsi_start] = vars[layout.epsi_start];
+
+    // The rest of the constraints
+    for (size_t t = 1; t < layout.N; ++t) {
+      /**
+       * DONE: Grab the rest of the states at t+1 and t.
+       *   We have given you parts of these states below.
+       */
+      AD<double> x1 = vars[layout.x_start + t];
+
+      AD<double> x0 = vars[layout.x_start + t - 1];
+      AD<double> psi0 = vars[layout.psi_start + t - 1];
+      AD<double> v0 = vars[layout.v_start + t - 1];
+
+      // Here's `x` to get you started.
+      // The idea here is to constraint this value to be 0.
+      //
+      // NOTE: The use of `AD<double>` and use of `CppAD`!
+      // CppAD can compute derivatives and pass these to the solver.
+      AD<double> y0 = vars[layout.y_start + t - 1];
+      AD<double> y1 = vars[layout.y_start + t];
+      AD<double> psi1 = vars[layout.psi_start + t];
+      AD<double> v1 = vars[layout.v_start + t];
+      AD<double> delta0 = vars[layout.delta_start + layout.Move(t - 1)];
+      AD<double> a0 = vars[layout.a_start + layout.Move(t - 1)];
+      AD<double> cte1 = vars[layout.cte_start + t];
+      AD<double> cte0 = vars[layout.cte_start + t - 1];
+      AD<double> epsi1 = vars[layout.epsi_start + t];
+      AD<double> epsi0 = vars[layout.epsi_start + t - 1];
+
+      /**
+       * DONE: Setup the rest of the model constraints
+       */
+      // Recall the equations for the model:
+      // x_[t] = x[t-1] + v[t-1] * cos(psi[t-1]) * dt
+      // y_[t] = y[t-1] + v[t-1] * sin(psi[t-1]) * dt
+      // psi_[t] = psi[t-1] + v[t-1] / Lf * delta[t-1] * dt
+      // v_[t] = v[t-1] + a[t-1] * dt
+      // cte[t] = f(x[t-1]) - y[t-1] + v[t-1] * sin(epsi[t-1]) * dt
+      // epsi[t] = psi[t] - psides[t-1] + v[t-1] * delta[t-1] / Lf * dt
+      // with dt the size of step t-1, which may differ between steps, and
+      // f the 3rd order polynomial; see ModelStepT().
+      const double dt = layout.Dt(t - 1);
+      const AD<double> s0[6] = {x0, y0, psi0, v0, cte0, epsi0};
+      AD<double> s1[6];
+      ModelStepT(s0, delta0, a0, &coeffs[0], dt, s1);
+
+      fg[1 + layout.x_start + t   ] = x1 - s1[kX];
+      fg[1 + layout.y_start + t   ] = y1 - s1[kY];
+      fg[1 + layout.psi_start + t ] = psi1 - s1[kPsi];
+      fg[1 + layout.v_start + t   ] = v1 - s1[kV];
+      fg[1 + layout.cte_start + t ] = cte1 - s1[kCte];
+      fg[1 + layout.epsi_start + t] = epsi1 - s1[kEpsi];
+    }
+  }
+};
+
+#endif  // FG_EVAL_H
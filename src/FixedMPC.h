@@ -0,0 +1,121 @@
+#ifndef FIXED_MPC_H
+#define FIXED_MPC_H
+
+#include <algorithm>
+#include <array>
+#include <memory>
+#include "Eigen-3.3/Eigen/Core"
+#include "FG_eval.h"
+#include "MPCNLP.h"
+#include "MPCProblem.h"
+#include "MPCTape.h"
+
+//
+// MPC with the horizon fixed at compile time.
+//
+// Same problem and solver path as the "ipopt" SolverBackend, but the
+// variable offsets are constant expressions (FixedLayout<kN>) and state,
+// warm start and result storage are fixed-size, so each horizon we deploy
+// is compiled as its own specialized kernel.
+//
+// It is not a SolverBackend and has none of the rest of MPC: no solve
+// deadline, no solution cache, no move blocking, time grid or horizons. In
+// main.cpp (FIXED_HORIZON_MPC) it replaces FleetMPC and the table, so
+// --solver, --cache and --table are ignored there, and all connected
+// vehicles share its one warm start.
+//
+template <size_t kN>
+class FixedMPC {
+ public:
+  typedef FixedLayout<kN> Layout;
+  typedef Eigen::Matrix<double, 6, 1> State;
+  typedef Eigen::Matrix<double, 4, 1> Coeffs;
+
+  // First actuations followed by the predicted (x, y) of steps 1..N-1, as
+  // returned by MPC::Solve.
+  static constexpr size_t kResultSize = 2 + 2 * (kN - 1);
+  typedef std::array<double, kResultSize> Result;
+
+  // Records the tape and sets up Ipopt, so that the first Solve() does
+  // not.
+  explicit FixedMPC(double dt = 0.1);
+
+  const Result &Solve(const State &state, const Coeffs &coeffs);
+
+  // Start each solve from the previous solution, shifted one step forward.
+  bool use_warm_start = true;
+
+  // Ipopt iterations of the last solve.
+  int last_iterations = -1;
+
+ private:
+  Layout layout_;
+  MPCTape tape_;
+  std::unique_ptr<PersistentIpopt> ipopt_;
+
+  bool warm_valid_ = false;
+  std::array<double, Layout::n_vars> warm_x_;
+  std::array<double, Layout::n_vars> warm_zl_;
+  std::array<double, Layout::n_vars> warm_zu_;
+  std::array<double, Layout::n_constraints> warm_lambda_;
+
+  Result result_;
+};
+
+template <size_t kN>
+constexpr size_t FixedMPC<kN>::kResultSize;
+
+template <size_t kN>
+FixedMPC<kN>::FixedMPC(double dt) : layout_(dt) {
+  FG_evalT<Layout> fg_eval(layout_);
+  SparsityPattern jac, hes;
+  MPCSparsityT(layout_, jac, hes);
+  tape_.Record(fg_eval, Layout::n_vars, Layout::n_constraints, 4, &jac,
+               &hes);
+  ipopt_.reset(new PersistentIpopt(tape_));
+}
+
+template <size_t kN>
+const typename FixedMPC<kN>::Result &FixedMPC<kN>::Solve(
+    const State &state, const Coeffs &coeffs) {
+  tape_.SetParameters(coeffs.data());
+
+  MPCNLP &nlp = ipopt_->nlp();
+  SetBoundsT(layout_, state.data(), &nlp.x_l[0], &nlp.x_u[0], &nlp.g_l[0],
+             &nlp.g_u[0]);
+
+  bool warm = use_warm_start && warm_valid_;
+  if (warm) {
+    ShiftWarmStartT(layout_, state.data(), coeffs.data(), warm_x_.data(),
+                    warm_zl_.data(), warm_zu_.data(), warm_lambda_.data());
+    std::copy(warm_x_.begin(), warm_x_.end(), nlp.x_init.begin());
+    std::copy(warm_zl_.begin(), warm_zl_.end(), nlp.z_L_init.begin());
+    std::copy(warm_zu_.begin(), warm_zu_.end(), nlp.z_U_init.begin());
+    std::copy(warm_lambda_.begin(), warm_lambda_.end(),
+              nlp.lambda_init.begin());
+  } else {
+    std::fill(nlp.x_init.begin(), nlp.x_init.end(), 0.0);
+  }
+
+  warm_valid_ = ipopt_->Solve(warm);
+  last_iterations = ipopt_->LastIterations();
+
+  const std::vector<double> &x = nlp.x_sol;
+  if (warm_valid_) {
+    std::copy(x.begin(), x.end(), warm_x_.begin());
+    std::copy(nlp.z_L_sol.begin(), nlp.z_L_sol.end(), warm_zl_.begin());
+    std::copy(nlp.z_U_sol.begin(), nlp.z_U_sol.end(), warm_zu_.begin());
+    std::copy(nlp.lambda_sol.begin(), nlp.lambda_sol.end(),
+              warm_lambda_.begin());
+  }
+
+  result_[0] = x[Layout::delta_start];
+  result_[1] = x[Layout::a_start];
+  for (size_t i = 0; i < kN - 1; ++i) {
+    result_[2 + 2 * i] = x[Layout::x_start + i + 1];
+    result_[3 + 2 * i] = x[Layout::y_start + i + 1];
+  }
+  return result_;
+}
+
+#endif  // FIXED_MPC_H
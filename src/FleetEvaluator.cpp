@@ -0,0 +1,164 @@
+#include "FleetEvaluator.h"
+#include <utility>
+
+using Eigen::ArrayXXd;
+using Eigen::ArrayXd;
+
+FleetEvaluator::FleetEvaluator(const MPCLayout &layout, size_t num_vehicles)
+    : delta(ArrayXXd::Zero(num_vehicles, layout.N - 1)),
+      a(ArrayXXd::Zero(num_vehicles, layout.N - 1)),
+      coeffs(ArrayXXd::Zero(num_vehicles, 4)),
+      grad_delta(ArrayXXd::Zero(num_vehicles, layout.N - 1)),
+      grad_a(ArrayXXd::Zero(num_vehicles, layout.N - 1)),
+      layout_(layout),
+      num_vehicles_(num_vehicles),
+      cost_(ArrayXd::Zero(num_vehicles)),
+      cos_psi_(num_vehicles, layout.N - 1),
+      sin_psi_(num_vehicles, layout.N - 1),
+      sin_epsi_(num_vehicles, layout.N - 1),
+      slope_(num_vehicles, layout.N - 1) {
+  for (size_t k = 0; k < 6; ++k) {
+    state[k].setZero(num_vehicles, layout.N);
+    lambda_[k].setZero(num_vehicles);
+    next_[k].setZero(num_vehicles);
+  }
+}
+
+void FleetEvaluator::SetVehicle(size_t i, const double *vars,
+                                const double *coeffs) {
+  for (size_t t = 0; t < layout_.N; ++t) {
+    for (size_t k = 0; k < 6; ++k) {
+      state[k](i, t) = vars[layout_.StateStart(k) + t];
+    }
+  }
+  for (size_t t = 0; t + 1 < layout_.N; ++t) {
+    delta(i, t) = vars[layout_.delta_start + t];
+    a(i, t) = vars[layout_.a_start + t];
+  }
+  for (size_t j = 0; j < 4; ++j) {
+    this->coeffs(i, j) = coeffs[j];
+  }
+}
+
+void FleetEvaluator::GetVehicle(size_t i, double *vars) const {
+  for (size_t t = 0; t < layout_.N; ++t) {
+    for (size_t k = 0; k < 6; ++k) {
+      vars[layout_.StateStart(k) + t] = state[k](i, t);
+    }
+  }
+  for (size_t t = 0; t + 1 < layout_.N; ++t) {
+    vars[layout_.delta_start + t] = delta(i, t);
+    vars[layout_.a_start + t] = a(i, t);
+  }
+}
+
+void FleetEvaluator::Rollout() {
+  auto c0 = coeffs.col(0);
+  auto c1 = coeffs.col(1);
+  auto c2 = coeffs.col(2);
+  auto c3 = coeffs.col(3);
+  // The model of ModelStep(), one step of all vehicles at a time. Eigen
+  // has no packet versions of the double precision sin, cos and atan, so
+  // these are evaluated once and kept for Gradient().
+  for (size_t t = 0; t + 1 < layout_.N; ++t) {
+    const double dt = layout_.Dt(t);
+    auto x0 = state[kX].col(t);
+    auto y0 = state[kY].col(t);
+    auto psi0 = state[kPsi].col(t);
+    auto v0 = state[kV].col(t);
+    auto epsi0 = state[kEpsi].col(t);
+    auto delta0 = delta.col(t);
+    cos_psi_.col(t) = psi0.cos();
+    sin_psi_.col(t) = psi0.sin();
+    sin_epsi_.col(t) = epsi0.sin();
+    slope_.col(t) = c1 + x0 * (2.0 * c2 + 3.0 * c3 * x0);
+    state[kX].col(t + 1) = x0 + v0 * cos_psi_.col(t) * dt;
+    state[kY].col(t + 1) = y0 + v0 * sin_psi_.col(t) * dt;
+    state[kPsi].col(t + 1) = psi0 + v0 / Lf * delta0 * dt;
+    state[kV].col(t + 1) = v0 + a.col(t) * dt;
+    state[kCte].col(t + 1) = c0 + x0 * (c1 + x0 * (c2 + x0 * c3)) - y0 +
+                             v0 * sin_epsi_.col(t) * dt;
+    state[kEpsi].col(t + 1) =
+        psi0 - slope_.col(t).atan() + v0 / Lf * delta0 * dt;
+  }
+}
+
+const ArrayXd &FleetEvaluator::Cost() {
+  // Summed column by column, i.e. over contiguous vehicles.
+  const size_t N = layout_.N;
+  cost_.setZero();
+  for (size_t t = 0; t < N; ++t) {
+    cost_ += w_cte * state[kCte].col(t).square() +
+             w_epsi * state[kEpsi].col(t).square() +
+             w_v * (state[kV].col(t) - ref_v).square();
+  }
+  for (size_t t = 0; t + 1 < N; ++t) {
+    cost_ += w_delta * delta.col(t).square() + w_a * a.col(t).square();
+  }
+  for (size_t t = 0; t + 2 < N; ++t) {
+    cost_ += w_ddelta * (delta.col(t + 1) - delta.col(t)).square() +
+             w_da * (a.col(t + 1) - a.col(t)).square();
+  }
+  return cost_;
+}
+
+void FleetEvaluator::Gradient() {
+  const size_t N = layout_.N;
+
+  // Direct terms of the actuations.
+  grad_delta = 2.0 * w_delta * delta;
+  grad_a = 2.0 * w_a * a;
+  if (N > 2) {
+    ArrayXXd rate = delta.rightCols(N - 2) - delta.leftCols(N - 2);
+    grad_delta.leftCols(N - 2) -= 2.0 * w_ddelta * rate;
+    grad_delta.rightCols(N - 2) += 2.0 * w_ddelta * rate;
+    rate = a.rightCols(N - 2) - a.leftCols(N - 2);
+    grad_a.leftCols(N - 2) -= 2.0 * w_da * rate;
+    grad_a.rightCols(N - 2) += 2.0 * w_da * rate;
+  }
+
+  // Adjoint sweep: lambda_ is the derivative of the cost with respect to
+  // the state of step t + 1, through all later steps. The transposed
+  // Jacobians are those of ModelJacobian().
+  auto c2 = coeffs.col(2);
+  auto c3 = coeffs.col(3);
+  lambda_[kX].setZero();
+  lambda_[kY].setZero();
+  lambda_[kPsi].setZero();
+  lambda_[kV] = 2.0 * w_v * (state[kV].col(N - 1) - ref_v);
+  lambda_[kCte] = 2.0 * w_cte * state[kCte].col(N - 1);
+  lambda_[kEpsi] = 2.0 * w_epsi * state[kEpsi].col(N - 1);
+  for (size_t t = N - 1; t-- > 0;) {
+    const double dt = layout_.Dt(t);
+    auto x0 = state[kX].col(t);
+    auto v0 = state[kV].col(t);
+    auto epsi0 = state[kEpsi].col(t);
+    auto delta0 = delta.col(t);
+    auto cos_psi0 = cos_psi_.col(t);
+    auto sin_psi0 = sin_psi_.col(t);
+    auto df0 = slope_.col(t);
+    grad_delta.col(t) += (lambda_[kPsi] + lambda_[kEpsi]) * v0 / Lf * dt;
+    grad_a.col(t) += lambda_[kV] * dt;
+    if (t == 0) {
+      break;  // the initial state is fixed
+    }
+
+    next_[kX] = lambda_[kX] + lambda_[kCte] * df0 -
+                lambda_[kEpsi] * (2.0 * c2 + 6.0 * c3 * x0) /
+                    (1.0 + df0.square());
+    next_[kY] = lambda_[kY] - lambda_[kCte];
+    next_[kPsi] = lambda_[kPsi] + lambda_[kEpsi] +
+                  v0 * dt * (lambda_[kY] * cos_psi0 - lambda_[kX] * sin_psi0);
+    next_[kV] = lambda_[kV] +
+                dt * (lambda_[kX] * cos_psi0 + lambda_[kY] * sin_psi0 +
+                      (lambda_[kPsi] + lambda_[kEpsi]) * delta0 / Lf +
+                      lambda_[kCte] * sin_epsi_.col(t)) +
+                2.0 * w_v * (v0 - ref_v);
+    next_[kCte] = 2.0 * w_cte * state[kCte].col(t);
+    next_[kEpsi] = lambda_[kCte] * v0 * epsi0.cos() * dt +
+                   2.0 * w_epsi * epsi0;
+    for (size_t k = 0; k < 6; ++k) {
+      lambda_[k].swap(next_[k]);
+    }
+  }
+}
@@ -0,0 +1,70 @@
+#ifndef FLEET_EVALUATOR_H
+#define FLEET_EVALUATOR_H
+
+#include <vector>
+#include "Eigen-3.3/Eigen/Core"
+#include "MPCProblem.h"
+
+//
+// Model rollout, cost and cost gradient of FG_evalT for many vehicles at
+// once, without CppAD.
+//
+// Trajectories are stored as structure of arrays: one vehicles x steps
+// array per state component and actuation, column major, so column t holds
+// step t of every vehicle contiguously. Every model step is a handful of
+// Eigen array expressions over all vehicles, which Eigen evaluates in SIMD
+// packets (SSE2 by default, AVX/AVX-512 with MPC_NATIVE_ARCH).
+//
+// The cost is that of the actuations alone (single shooting): the states
+// follow from the initial states and actuations by Rollout(), and
+// Gradient() is the derivative of Cost() with respect to delta and a, by
+// one adjoint sweep backwards through the model. Every step has actuations
+// of its own, so `layout` must not use move blocking.
+//
+class FleetEvaluator {
+ public:
+  FleetEvaluator(const MPCLayout &layout, size_t num_vehicles);
+
+  const MPCLayout &Layout() const { return layout_; }
+  size_t NumVehicles() const { return num_vehicles_; }
+
+  // States, vehicles x N, indexed by kX..kEpsi; column 0 are the initial
+  // states.
+  Eigen::ArrayXXd state[6];
+  // Actuations, vehicles x (N - 1).
+  Eigen::ArrayXXd delta;
+  Eigen::ArrayXXd a;
+  // Polynomial coefficients, vehicles x 4.
+  Eigen::ArrayXXd coeffs;
+
+  // Copy vehicle `i` from or to a variable vector in the order of the
+  // layout (as used by the solver backends).
+  void SetVehicle(size_t i, const double *vars, const double *coeffs);
+  void GetVehicle(size_t i, double *vars) const;
+
+  // States of steps 1..N-1 from the initial states and the actuations.
+  void Rollout();
+
+  // Cost of every vehicle, as MPCCost(), for the current trajectories.
+  const Eigen::ArrayXd &Cost();
+
+  // Derivative of Cost() with respect to the actuations, vehicles x
+  // (N - 1) each, for the trajectories of the last Rollout(), which must
+  // not have changed since.
+  void Gradient();
+  Eigen::ArrayXXd grad_delta;
+  Eigen::ArrayXXd grad_a;
+
+ private:
+  MPCLayout layout_;
+  size_t num_vehicles_;
+  Eigen::ArrayXd cost_;
+  // Terms of the last Rollout() reused by Gradient(), vehicles x (N - 1):
+  // cos and sin of psi, sin of epsi and the slope f' of the reference line.
+  Eigen::ArrayXXd cos_psi_, sin_psi_, sin_epsi_, slope_;
+  // Adjoints of the state components and the next step's values.
+  Eigen::ArrayXd lambda_[6];
+  Eigen::ArrayXd next_[6];
+};
+
+#endif  // FLEET_EVALUATOR_H
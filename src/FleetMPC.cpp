@@ -0,0 +1,129 @@
+#include "FleetMPC.h"
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include "MPCTape.h"
+
+FleetMPC::FleetMPC(int num_threads) : solver_name_("ipopt") {
+  SetupCppADThreads();
+  if (num_threads <= 0) {
+    num_threads = std::max<int>(1, std::thread::hardware_concurrency());
+  }
+  // Every worker may record and evaluate tapes.
+  num_threads_ = ReserveCppADThreads(num_threads);
+  if (num_threads_ > 0) {
+    pool_.reset(new Eigen::NonBlockingThreadPool(num_threads_));
+  }
+}
+
+FleetMPC::~FleetMPC() {
+  // Vehicles and the pool go first; the workers give back their CppAD
+  // thread numbers when they exit.
+  vehicles_.clear();
+  pool_.reset();
+  ReleaseCppADThreads(num_threads_);
+}
+
+bool FleetMPC::Supports(const std::string &name,
+                        const std::vector<size_t> &blocks) const {
+  return MPC::Supports(name, blocks, step_sizes_, horizons);
+}
+
+bool FleetMPC::SetSolver(const std::string &name) {
+  if (!Supports(name, move_blocks_)) {
+    return false;
+  }
+  solver_name_ = name;
+  return true;
+}
+
+bool FleetMPC::SetMoveBlocks(const std::vector<size_t> &blocks) {
+  if (!Supports(solver_name_, blocks)) {
+    return false;
+  }
+  move_blocks_ = blocks;
+  return true;
+}
+
+bool FleetMPC::SetStepSizes(const std::vector<double> &dts) {
+  if (!MPC::Supports(solver_name_, move_blocks_, dts, horizons)) {
+    return false;
+  }
+  step_sizes_ = dts;
+  return true;
+}
+
+size_t FleetMPC::AddVehicle() {
+  std::unique_ptr<MPC> mpc(new MPC);
+  mpc->Configure(solver_name_, move_blocks_, step_sizes_, horizons);
+  mpc->verbose = verbose;
+  mpc->cache.Configure(cache);
+  for (size_t id = 0; id < vehicles_.size(); ++id) {
+    if (!vehicles_[id]) {
+      vehicles_[id] = std::move(mpc);
+      return id;
+    }
+  }
+  vehicles_.push_back(std::move(mpc));
+  return vehicles_.size() - 1;
+}
+
+void FleetMPC::RemoveVehicle(size_t id) { vehicles_[id].reset(); }
+
+size_t FleetMPC::NumVehicles() const {
+  size_t n = 0;
+  for (const std::unique_ptr<MPC> &mpc : vehicles_) {
+    n += (mpc != nullptr);
+  }
+  return n;
+}
+
+std::vector<std::vector<double> > FleetMPC::Solve(
+    const std::vector<Request> &batch) {
+  std::vector<std::vector<double> > results(batch.size());
+  ParallelFor(batch.size(), [&](size_t i) {
+    MPC &mpc = *vehicles_[batch[i].vehicle];
+    std::unique_lock<std::mutex> lock(serial_mutex_, std::defer_lock);
+    if (!SolverBackendIsThreadSafe(mpc.SolverName())) {
+      lock.lock();
+    }
+    mpc.deadline = deadline;
+    results[i] = mpc.Solve(batch[i].state, batch[i].coeffs);
+  });
+  return results;
+}
+
+void FleetMPC::Prepare(const std::vector<size_t> &vehicles) {
+  ParallelFor(vehicles.size(), [&](size_t i) {
+    MPC &mpc = *vehicles_[vehicles[i]];
+    std::unique_lock<std::mutex> lock(serial_mutex_, std::defer_lock);
+    if (!SolverBackendIsThreadSafe(mpc.SolverName())) {
+      lock.lock();
+    }
+    mpc.Prepare();
+  });
+}
+
+void FleetMPC::ParallelFor(size_t n, const std::function<void(size_t)> &fn) {
+  if (!pool_) {
+    for (size_t i = 0; i < n; ++i) {
+      fn(i);
+    }
+    return;
+  }
+  std::mutex mutex;
+  std::condition_variable finished;
+  size_t num_left = n;
+  for (size_t i = 0; i < n; ++i) {
+    pool_->Schedule([&, i] {
+      fn(i);
+      std::lock_guard<std::mutex> lock(mutex);
+      if (--num_left == 0) {
+        finished.notify_one();
+      }
+    });
+  }
+  std::unique_lock<std::mutex> lock(mutex);
+  finished.wait(lock, [&] { return num_left == 0; });
+}
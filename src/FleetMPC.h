@@ -0,0 +1,113 @@
+#ifndef FLEET_MPC_H
+#define FLEET_MPC_H
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Eigen-3.3/Eigen/Core"
+#include "Eigen-3.3/unsupported/Eigen/CXX11/ThreadPool"
+#include "MPC.h"
+
+//
+// MPC of many independent vehicles in one process.
+//
+// Every vehicle is an MPC of its own, with its own solver backend, warm
+// start and previous actuations. Solve() takes a batch of vehicles and
+// solves them concurrently on a work stealing thread pool (Eigen's
+// NonBlockingThreadPool: every worker has its own queue and steals from the
+// others when it runs dry), so a few slow solves do not hold up the rest.
+// The pool has at most as many threads as CppAD thread numbers could be
+// reserved for it (see ReserveCppADThreads()); without any, batches are
+// solved one vehicle after the other on the calling thread.
+//
+// NOTE: vehicles whose backend is not thread-safe (see
+// SolverBackendIsThreadSafe()), e.g. Ipopt 3.12 with MUMPS, which corrupts
+// memory when called concurrently, are solved one at a time: they only
+// overlap with vehicles of other backends.
+//
+class FleetMPC {
+ public:
+  // Solve on `num_threads` threads, by default one per core.
+  explicit FleetMPC(int num_threads = 0);
+  ~FleetMPC();
+
+  // Backend of the vehicles added from now on (see SolverBackendNames()).
+  // Returns false, keeping the current one, for an unknown name. The
+  // default is "ipopt".
+  bool SetSolver(const std::string &name);
+  const std::string &SolverName() const { return solver_name_; }
+
+  // Move blocking of the vehicles added from now on (see
+  // MPC::SetMoveBlocks()). Returns false, keeping the current blocks, if
+  // the backend does not support it; SetSolver() likewise rejects such
+  // backends while blocks are set.
+  bool SetMoveBlocks(const std::vector<size_t> &blocks);
+  const std::vector<size_t> &MoveBlocks() const { return move_blocks_; }
+
+  // Time grid of the vehicles added from now on (see MPC::SetStepSizes()).
+  // Returns false, keeping the current grid, for a step size that is not
+  // positive or a grid the backend does not support.
+  bool SetStepSizes(const std::vector<double> &dts);
+  const std::vector<double> &StepSizes() const { return step_sizes_; }
+
+  // Print a line per solve. Set for the vehicles added from now on; the
+  // lines of concurrent solves interleave.
+  bool verbose = false;
+
+  // Solution cache of the vehicles added from now on, each its own.
+  SolutionCache::Options cache;
+
+  // Horizon scheduling of the vehicles added from now on (see
+  // MPC::SetHorizons()); each vehicle measures its own solve times. Not
+  // with a grid of SetStepSizes().
+  HorizonScheduler::Options horizons;
+
+  // Add a vehicle and return its id. Ids of removed vehicles are reused.
+  size_t AddVehicle();
+  void RemoveVehicle(size_t id);
+  size_t NumVehicles() const;
+
+  MPC &Vehicle(size_t id) { return *vehicles_[id]; }
+  const MPC &Vehicle(size_t id) const { return *vehicles_[id]; }
+
+  // One vehicle of a batch: its id, initial state and polynomial
+  // coefficients as for MPC::Solve().
+  struct Request {
+    size_t vehicle;
+    Eigen::VectorXd state;
+    Eigen::VectorXd coeffs;
+  };
+
+  // Solve all requests concurrently and return the results of MPC::Solve()
+  // in the same order. A vehicle may appear only once per batch.
+  std::vector<std::vector<double> > Solve(const std::vector<Request> &batch);
+
+  // MPC::Prepare() of the vehicles, concurrently.
+  void Prepare(const std::vector<size_t> &vehicles);
+
+  // Deadline of every solve of the next batch.
+  Deadline deadline;
+
+ private:
+  // Run fn(0), ..., fn(n - 1) on the pool and wait for all of them.
+  void ParallelFor(size_t n, const std::function<void(size_t)> &fn);
+
+  // Whether the vehicles accept backend `name` with move blocking
+  // `blocks`, the current grid and horizons.
+  bool Supports(const std::string &name,
+                const std::vector<size_t> &blocks) const;
+
+  std::vector<std::unique_ptr<MPC> > vehicles_;
+  std::string solver_name_;
+  std::vector<size_t> move_blocks_;
+  std::vector<double> step_sizes_;
+  std::unique_ptr<Eigen::NonBlockingThreadPool> pool_;
+  size_t num_threads_ = 0;
+  // Held by the solves and preparations of backends that are not
+  // thread-safe.
+  std::mutex serial_mutex_;
+};
+
+#endif  // FLEET_MPC_H
@@ -0,0 +1,98 @@
+#include "HorizonScheduler.h"
+#include <cmath>
+
+void HorizonScheduler::Configure(const Options &options) {
+  options_ = options;
+  solve_ms_.assign(options_.horizons.size(), -1.0);
+  last_frame_.assign(options_.horizons.size(), -1);
+  step_ms_ = -1.0;
+  frame_ = 0;
+  current_ = 0;
+  pending_ = 0;
+  pending_frames_ = 0;
+}
+
+double HorizonScheduler::PredictedMs(size_t index) const {
+  if (last_frame_[index] >= 0 &&
+      frame_ - last_frame_[index] <= options_.memory_frames) {
+    return solve_ms_[index];
+  }
+  // Nothing known yet counts as within the budget.
+  return step_ms_ >= 0.0 ? step_ms_ * options_.horizons[index].N : 0.0;
+}
+
+size_t HorizonScheduler::Choose(double v) const {
+  const std::vector<Horizon> &horizons = options_.horizons;
+  const double speed = std::fabs(v);
+  // Of the candidates within the budget the longest lookahead within the
+  // distance and the shortest beyond it; the fastest of all.
+  int longest = -1, shortest = -1, fastest = 0;
+  for (size_t i = 0; i < horizons.size(); ++i) {
+    const double ms = PredictedMs(i);
+    if (ms < PredictedMs(fastest)) {
+      fastest = i;
+    }
+    if (ms > options_.budget_ms) {
+      continue;
+    }
+    const double lookahead = horizons[i].N * horizons[i].dt;
+    if (speed * lookahead <= options_.max_lookahead) {
+      if (longest < 0) {
+        longest = i;
+        continue;
+      }
+      const double best = horizons[longest].N * horizons[longest].dt;
+      if (lookahead > best ||
+          (lookahead == best && horizons[i].dt < horizons[longest].dt)) {
+        longest = i;
+      }
+    } else if (shortest < 0 ||
+               lookahead < horizons[shortest].N * horizons[shortest].dt) {
+      shortest = i;
+    }
+  }
+  if (longest >= 0) {
+    return longest;
+  }
+  return shortest >= 0 ? shortest : fastest;
+}
+
+size_t HorizonScheduler::Select(double v) {
+  if (!Enabled()) {
+    return 0;
+  }
+  const size_t choice = Choose(v);
+  if (choice == current_) {
+    pending_frames_ = 0;
+  } else if (PredictedMs(current_) > options_.budget_ms) {
+    current_ = choice;
+    pending_frames_ = 0;
+  } else {
+    if (choice != pending_) {
+      pending_ = choice;
+      pending_frames_ = 0;
+    }
+    if (++pending_frames_ >= options_.min_frames) {
+      current_ = choice;
+      pending_frames_ = 0;
+    }
+  }
+  return current_;
+}
+
+void HorizonScheduler::RecordSolve(size_t index, double solve_ms) {
+  if (!Enabled()) {
+    return;
+  }
+  ++frame_;
+  const double alpha = options_.smoothing;
+  if (last_frame_[index] >= 0 &&
+      frame_ - last_frame_[index] <= options_.memory_frames) {
+    solve_ms_[index] += alpha * (solve_ms - solve_ms_[index]);
+  } else {
+    solve_ms_[index] = solve_ms;
+  }
+  last_frame_[index] = frame_;
+  const double step_ms = solve_ms / options_.horizons[index].N;
+  step_ms_ = step_ms_ < 0.0 ? step_ms : step_ms_ + alpha * (step_ms - step_ms_);
+}
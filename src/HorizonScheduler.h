@@ -0,0 +1,84 @@
+#ifndef HORIZON_SCHEDULER_H
+#define HORIZON_SCHEDULER_H
+
+#include <cstddef>
+#include <vector>
+
+//
+// Chooses the horizon of every frame, the number of steps N and the step
+// size dt, among a fixed set of candidates, to keep the solves within a
+// latency budget while looking as far ahead as possible.
+//
+// The solve time of every candidate is an exponential moving average of
+// its recent solves. Candidates without recent solves are predicted from
+// the average time per step of all solves, i.e. as linear in N. Of the
+// candidates predicted within the budget the one with the longest lookahead
+// N * dt wins whose distance at the current speed, v * N * dt, stays within
+// max_lookahead (the polynomial fits the waypoints ahead and is not valid
+// much beyond them); ties go to the smaller dt. If every candidate goes
+// beyond max_lookahead the shortest one within the budget wins, and if none
+// is within the budget the fastest.
+//
+// A switch starts the solver of the new horizon cold, so a new choice is
+// only taken once it has been the choice for min_frames frames in a row,
+// except that a current horizon over the budget is left at once. Solve
+// times are forgotten after memory_frames frames, so a horizon that was
+// over the budget once, e.g. while the machine was busy, is tried again.
+//
+class HorizonScheduler {
+ public:
+  struct Horizon {
+    size_t N;
+    double dt;
+  };
+
+  struct Options {
+    // Candidates; the first one is used until solve times are known. Fewer
+    // than two disable the scheduling.
+    std::vector<Horizon> horizons;
+    // Solve time to stay within.
+    double budget_ms = 20.0;
+    // Longest distance to look ahead, in the units of v times seconds.
+    double max_lookahead = 60.0;
+    // Weight of the latest solve in the moving averages.
+    double smoothing = 0.2;
+    int min_frames = 10;
+    // Solve times of a candidate older than this many frames are forgotten.
+    int memory_frames = 100;
+  };
+
+  HorizonScheduler() {}
+
+  // Set the options and forget all solve times.
+  void Configure(const Options &options);
+  const Options &GetOptions() const { return options_; }
+  bool Enabled() const { return options_.horizons.size() > 1; }
+
+  // Index of the horizon of the next solve at speed `v`.
+  size_t Select(double v);
+  size_t Current() const { return current_; }
+
+  // Time of a solve with horizon `index`.
+  void RecordSolve(size_t index, double solve_ms);
+
+  double PredictedMs(size_t index) const;
+
+ private:
+  // Best horizon for speed `v` with the current predictions.
+  size_t Choose(double v) const;
+
+  Options options_;
+  // Moving average and frame of the last solve of every candidate, -1 if
+  // never solved.
+  std::vector<double> solve_ms_;
+  std::vector<long> last_frame_;
+  // Moving average of the time per step of all solves, -1 before any.
+  double step_ms_ = -1.0;
+  long frame_ = 0;
+
+  size_t current_ = 0;
+  size_t pending_ = 0;
+  int pending_frames_ = 0;
+};
+
+#endif  // HORIZON_SCHEDULER_H
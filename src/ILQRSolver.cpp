@@ -0,0 +1,297 @@
+#include "ILQRSolver.h"
+#include <algorithm>
+#include <limits>
+#include "Eigen-3.3/Eigen/Cholesky"
+#include "Eigen-3.3/Eigen/LU"
+#include "MPCAutoDiff.h"
+
+using Eigen::Matrix2d;
+using Eigen::Vector2d;
+using Eigen::VectorXd;
+
+namespace {
+
+typedef Eigen::Matrix<double, 8, 1> Vector8d;
+
+// min 0.5 k'H k + g'k  s.t.  lo <= k <= hi, for a positive definite 2x2 H.
+// The minimizer has one of the 3x3 patterns of free/lower/upper components;
+// every pattern is tried and the best feasible candidate kept. `clamped`
+// marks the components at a bound.
+template <typename Scalar>
+Eigen::Matrix<Scalar, 2, 1> BoxQP2(const Eigen::Matrix<Scalar, 2, 2> &H,
+                                   const Eigen::Matrix<Scalar, 2, 1> &g,
+                                   const Eigen::Matrix<Scalar, 2, 1> &lo,
+                                   const Eigen::Matrix<Scalar, 2, 1> &hi,
+                                   bool clamped[2]) {
+  typedef Eigen::Matrix<Scalar, 2, 1> Vector2;
+  const Scalar tol = std::is_same<Scalar, double>::value ? 1.0e-12 : 1.0e-6;
+  Vector2 best = Vector2::Zero();
+  Scalar best_value = std::numeric_limits<Scalar>::infinity();
+  for (int m0 = 0; m0 < 3; ++m0) {
+    for (int m1 = 0; m1 < 3; ++m1) {
+      const int mode[2] = {m0, m1};
+      Vector2 k;
+      for (int i = 0; i < 2; ++i) {
+        k[i] = mode[i] == 1 ? lo[i] : hi[i];
+      }
+      if (m0 == 0 && m1 == 0) {
+        k = H.llt().solve(-g);
+      } else {
+        for (int i = 0; i < 2; ++i) {
+          if (mode[i] == 0) {
+            int j = 1 - i;
+            k[i] = -(g[i] + H(i, j) * k[j]) / H(i, i);
+          }
+        }
+      }
+      if ((k.array() < lo.array() - tol).any() ||
+          (k.array() > hi.array() + tol).any()) {
+        continue;
+      }
+      Scalar value = Scalar(0.5) * k.dot(H * k) + g.dot(k);
+      if (value < best_value) {
+        best_value = value;
+        best = k;
+        clamped[0] = m0 != 0;
+        clamped[1] = m1 != 0;
+      }
+    }
+  }
+  return best;
+}
+
+}  // namespace
+
+template <typename Scalar>
+ILQRSolverT<Scalar>::ILQRSolverT(const MPCLayout &layout)
+    : SolverBackend(layout),
+      z_(VectorXd::Zero(layout.n_vars)),
+      z_new_(VectorXd::Zero(layout.n_vars)),
+      k_(layout.N - 1, Vector2::Zero()),
+      K_(layout.N - 1, Matrix28::Zero()) {}
+
+template <typename Scalar>
+bool ILQRSolverT<Scalar>::BackwardPass(const double *coeffs) {
+  const size_t N = layout_.N;
+  Matrix2 R = Matrix2::Zero();
+  R.diagonal() << Scalar(2.0 * w_delta), Scalar(2.0 * w_a);
+  Matrix2 W = Matrix2::Zero();
+  W.diagonal() << Scalar(2.0 * w_ddelta), Scalar(2.0 * w_da);
+
+  // Cost of the states (cte, epsi, v) of step t, added to lx and lxx.
+  auto state_cost = [&](size_t t, Vector8 &lx, Matrix8 &lxx) {
+    lx[kCte] += Scalar(2.0 * w_cte * z_[layout_.cte_start + t]);
+    lx[kEpsi] += Scalar(2.0 * w_epsi * z_[layout_.epsi_start + t]);
+    lx[kV] += Scalar(2.0 * w_v * (z_[layout_.v_start + t] - ref_v));
+    lxx(kCte, kCte) += Scalar(2.0 * w_cte);
+    lxx(kEpsi, kEpsi) += Scalar(2.0 * w_epsi);
+    lxx(kV, kV) += Scalar(2.0 * w_v);
+  };
+
+  Vector8 Vx = Vector8::Zero();
+  Matrix8 Vxx = Matrix8::Zero();
+  state_cost(N - 1, Vx, Vxx);
+  dV1_ = 0.0;
+  dV2_ = 0.0;
+
+  for (size_t t = N - 1; t-- > 0;) {
+    Vector6d s = StateAt(layout_, z_.data(), t);
+    Vector2d u(z_[layout_.delta_start + t], z_[layout_.a_start + t]);
+
+    Matrix6d A;
+    Matrix62d B;
+    ModelJacobianDual(s, u[0], u[1], coeffs, layout_.Dt(t), A, B);
+    Matrix8 Fx = Matrix8::Zero();
+    Fx.template topLeftCorner<6, 6>() = A.cast<Scalar>();
+    Matrix82 Fu;
+    Fu.template topRows<6>() = B.cast<Scalar>();
+    Fu.template bottomRows<2>().setIdentity();
+
+    Vector8 lx = Vector8::Zero();
+    Matrix8 lxx = Matrix8::Zero();
+    state_cost(t, lx, lxx);
+    Vector2 lu = R * u.cast<Scalar>();
+    Matrix2 luu = R;
+    Matrix28 lux = Matrix28::Zero();
+    if (t > 0) {
+      // Rate penalty against the previous actuation in the augmented state.
+      Vector2d p(z_[layout_.delta_start + t - 1], z_[layout_.a_start + t - 1]);
+      Vector2 d = W * (u - p).cast<Scalar>();
+      lu += d;
+      luu += W;
+      lx.template tail<2>() -= d;
+      lxx.template bottomRightCorner<2, 2>() += W;
+      lux.template rightCols<2>() = -W;
+    }
+
+    Vector8 Qx = lx + Fx.transpose() * Vx;
+    Vector2 Qu = lu + Fu.transpose() * Vx;
+    Matrix8 Qxx = lxx + Fx.transpose() * Vxx * Fx;
+    Matrix2 Quu = luu + Fu.transpose() * Vxx * Fu;
+    Matrix28 Qux = lux + Fu.transpose() * Vxx * Fx;
+    Matrix2 Quu_reg = Quu + Scalar(mu_) * Matrix2::Identity();
+    if (Quu_reg(0, 0) <= 0 || Quu_reg.determinant() <= 0) {
+      return false;
+    }
+
+    size_t id = layout_.delta_start + t;
+    size_t ia = layout_.a_start + t;
+    Vector2 lo(lb[id] - u[0], lb[ia] - u[1]);
+    Vector2 hi(ub[id] - u[0], ub[ia] - u[1]);
+    bool clamped[2] = {false, false};
+    Vector2 k = BoxQP2<Scalar>(Quu_reg, Qu, lo, hi, clamped);
+
+    // Feedback on the free actuations only.
+    Matrix28 K = Matrix28::Zero();
+    if (!clamped[0] && !clamped[1]) {
+      K = -Quu_reg.llt().solve(Qux);
+    } else {
+      for (int i = 0; i < 2; ++i) {
+        if (!clamped[i]) {
+          K.row(i) = -Qux.row(i) / Quu_reg(i, i);
+        }
+      }
+    }
+    k_[t] = k;
+    K_[t] = K;
+
+    dV1_ += k.dot(Qu);
+    dV2_ += Scalar(0.5) * k.dot(Quu * k);
+    Vx = Qx + K.transpose() * Quu * k + K.transpose() * Qu +
+         Qux.transpose() * k;
+    Vxx = Qxx + K.transpose() * Quu * K + K.transpose() * Qux +
+          Qux.transpose() * K;
+    Vxx = Scalar(0.5) * (Vxx + Vxx.transpose()).eval();
+  }
+  return true;
+}
+
+template <typename Scalar>
+double ILQRSolverT<Scalar>::ForwardPass(double alpha, const double *coeffs) {
+  const size_t N = layout_.N;
+  z_new_ = z_;
+  Vector8d dx = Vector8d::Zero();
+  for (size_t t = 0; t + 1 < N; ++t) {
+    Vector6d s = StateAt(layout_, z_new_.data(), t);
+    dx.head<6>() = s - StateAt(layout_, z_.data(), t);
+
+    size_t id = layout_.delta_start + t;
+    size_t ia = layout_.a_start + t;
+    Vector2d u_bar(z_[id], z_[ia]);
+    Vector2d u = u_bar + alpha * k_[t].template cast<double>() +
+                 K_[t].template cast<double>() * dx;
+    u[0] = std::min(std::max(u[0], lb[id]), ub[id]);
+    u[1] = std::min(std::max(u[1], lb[ia]), ub[ia]);
+    z_new_[id] = u[0];
+    z_new_[ia] = u[1];
+    dx.tail<2>() = u - u_bar;
+
+    SetStateAt(layout_, ModelStep(s, u[0], u[1], coeffs, layout_.Dt(t)),
+               t + 1, z_new_.data());
+  }
+  return MPCCost(layout_, z_new_.data());
+}
+
+template <typename Scalar>
+void ILQRSolverT<Scalar>::ResetWarmStart() {
+  z_.setZero();
+  has_solution_ = false;
+}
+
+template <typename Scalar>
+bool ILQRSolverT<Scalar>::SolveImpl(const VectorXd &state,
+                                    const VectorXd &coeffs) {
+  const size_t N = layout_.N;
+  const double mu_min = 1.0e-6;
+  const double mu_max = 1.0e10;
+
+  if (!use_warm_start || !has_solution_) {
+    if (static_cast<size_t>(initial_guess.size()) == layout_.n_vars) {
+      z_ = initial_guess;
+    } else {
+      z_.setZero();
+    }
+  } else {
+    ShiftBlock(z_.data(), layout_.delta_start, N - 1);
+    ShiftBlock(z_.data(), layout_.a_start, N - 1);
+  }
+  for (size_t i = layout_.delta_start; i < layout_.n_vars; ++i) {
+    z_[i] = std::min(std::max(z_[i], lb[i]), ub[i]);
+  }
+  SetStateAt(layout_, state, 0, z_.data());
+  RolloutT(layout_, coeffs.data(), z_.data());
+  double cost = MPCCost(layout_, z_.data());
+
+  bool converged = false;
+  auto start = Deadline::Clock::now();
+  for (last_iterations_ = 0; last_iterations_ < max_iterations;) {
+    // The nominal trajectory is always feasible; stop with it if another
+    // iteration of the average length would miss the deadline.
+    if (last_iterations_ > 0) {
+      double iteration_ms = std::chrono::duration<double, std::milli>(
+                                Deadline::Clock::now() - start)
+                                .count() /
+                            last_iterations_;
+      if (deadline.Near(iteration_ms)) {
+        deadline_hit_ = true;
+        break;
+      }
+    }
+    ++last_iterations_;
+    while (!BackwardPass(coeffs.data())) {
+      mu_ = std::max(mu_ * 10.0, mu_min);
+      if (mu_ > mu_max) {
+        break;
+      }
+    }
+    if (mu_ > mu_max) {
+      mu_ = mu_min;
+      break;
+    }
+
+    // Backtracking line search on the actual cost.
+    bool accepted = false;
+    double new_cost = cost;
+    for (double alpha = 1.0; alpha > 1.0e-3; alpha *= 0.5) {
+      new_cost = ForwardPass(alpha, coeffs.data());
+      if (new_cost < cost) {
+        accepted = true;
+        break;
+      }
+    }
+
+    if (!accepted) {
+      // No descent along the computed step: converged if the model
+      // predicted none either, otherwise regularize and retry.
+      if (-dV1_ <= tolerance * cost) {
+        converged = true;
+        break;
+      }
+      mu_ *= 10.0;
+      if (mu_ > mu_max) {
+        mu_ = mu_min;
+        break;
+      }
+      continue;
+    }
+
+    double improvement = cost - new_cost;
+    z_.swap(z_new_);
+    cost = new_cost;
+    mu_ = std::max(mu_ / 10.0, mu_min);
+    if (improvement <= tolerance * cost) {
+      converged = true;
+      break;
+    }
+  }
+
+  has_solution_ = z_.allFinite();
+  if (!has_solution_) {
+    z_.setZero();
+    return false;
+  }
+  return converged || deadline_hit_;
+}
+
+template class ILQRSolverT<double>;
+template class ILQRSolverT<float>;
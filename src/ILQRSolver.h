@@ -0,0 +1,83 @@
+#ifndef ILQR_SOLVER_H
+#define ILQR_SOLVER_H
+
+#include <type_traits>
+#include <vector>
+#include "Eigen-3.3/Eigen/Core"
+#include "MPCProblem.h"
+#include "SolverBackend.h"
+
+//
+// Iterative LQR with box-constrained controls (box-DDP) for the MPC problem.
+//
+// The rate penalty of FG_evalT couples consecutive actuations, so the
+// Riccati recursion runs on the state augmented with the previous
+// actuation, x_t = (s_t, u_{t-1}), of dimension 8. Each iteration is one
+// backward sweep with the analytic Jacobians of ModelJacobian and a 2x2 box
+// QP per step for the feedforward term (the feedback gain acts on the free
+// actuations only), followed by a forward rollout of the nonlinear model
+// with a backtracking line search. Cost per iteration is linear in N.
+//
+// Every solve starts from the previous actuations shifted one step forward.
+// A deadline is checked between iterations.
+// Only the actuation bounds in lb and ub are used; the states are free.
+// Move blocking is not supported.
+//
+// Scalar is the precision of the backward sweep. The forward rollout and
+// the cost of the line search are always in double: with float, gains of
+// lower accuracy only make a step less of a Newton step, and the next
+// iteration, linearized around the trajectory in double, refines it.
+//
+template <typename Scalar>
+class ILQRSolverT : public SolverBackend {
+ public:
+  typedef Eigen::Matrix<Scalar, 2, 1> Vector2;
+  typedef Eigen::Matrix<Scalar, 8, 1> Vector8;
+  typedef Eigen::Matrix<Scalar, 2, 2> Matrix2;
+  typedef Eigen::Matrix<Scalar, 8, 8> Matrix8;
+  typedef Eigen::Matrix<Scalar, 2, 8> Matrix28;
+  typedef Eigen::Matrix<Scalar, 8, 2> Matrix82;
+
+  explicit ILQRSolverT(const MPCLayout &layout);
+
+  int max_iterations = 10;
+  // Stop once an iteration improves the cost by less than this fraction.
+  double tolerance = 1.0e-6;
+
+  const char *Name() const override {
+    return std::is_same<Scalar, double>::value ? "ilqr" : "ilqr-f32";
+  }
+  void ResetWarmStart() override;
+  const Eigen::VectorXd &Solution() const override { return z_; }
+
+ protected:
+  bool SolveImpl(const Eigen::VectorXd &state,
+                 const Eigen::VectorXd &coeffs) override;
+  int LastIterations() const override { return last_iterations_; }
+
+ private:
+  bool BackwardPass(const double *coeffs);
+  double ForwardPass(double alpha, const double *coeffs);
+
+  // Nominal trajectory (z_) and the candidate of the line search.
+  Eigen::VectorXd z_;
+  Eigen::VectorXd z_new_;
+  bool has_solution_ = false;
+  int last_iterations_ = -1;
+
+  // Levenberg-Marquardt regularization of Quu.
+  double mu_ = 1.0e-6;
+
+  // Feedforward terms and feedback gains.
+  std::vector<Vector2, Eigen::aligned_allocator<Vector2> > k_;
+  std::vector<Matrix28, Eigen::aligned_allocator<Matrix28> > K_;
+  // Expected cost change of a full step: alpha dV1 + alpha^2 dV2.
+  double dV1_ = 0.0;
+  double dV2_ = 0.0;
+};
+
+typedef ILQRSolverT<double> ILQRSolver;
+// Backward sweep in float.
+typedef ILQRSolverT<float> ILQRSolverF;
+
+#endif  // ILQR_SOLVER_H
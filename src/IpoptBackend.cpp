@@ -0,0 +1,193 @@
+#include "IpoptBackend.h"
+#include <cppad/cppad.hpp>
+#include <cppad/ipopt/solve.hpp>
+#include <algorithm>
+#include <string>
+#include <utility>
+#include "FG_eval.h"
+#include "MPCAnalyticDerivatives.h"
+#include "MPCNLP.h"
+#include "MPCTape.h"
+
+using Eigen::VectorXd;
+
+typedef CPPAD_TESTVECTOR(double) Dvector;
+
+IpoptBackend::IpoptBackend(const MPCLayout &layout, bool persistent_tape,
+                           bool analytic_derivatives)
+    : SolverBackend(layout),
+      persistent_tape_(persistent_tape),
+      analytic_derivatives_(persistent_tape && analytic_derivatives),
+      solution_(VectorXd::Zero(layout.n_vars)) {}
+
+IpoptBackend::~IpoptBackend() {}
+
+bool IpoptBackend::SolveImpl(const VectorXd &state, const VectorXd &coeffs) {
+  // Warm start from the previous solution if there is one.
+  bool warm = use_warm_start && warm_x_.size() == layout_.n_vars;
+  if (warm) {
+    ShiftWarmStartT(layout_, state.data(), coeffs.data(), &warm_x_[0],
+                    &warm_zl_[0], &warm_zu_[0], &warm_lambda_[0]);
+  }
+
+  bool ok = persistent_tape_ ? SolvePersistent(state, coeffs, warm)
+                             : SolveLegacy(state, coeffs, warm);
+
+  // A failed solve is not a good starting point, so start the next one
+  // from scratch.
+  if (!ok) {
+    warm_x_.clear();
+  }
+  return ok;
+}
+
+// Solve through the long-lived Ipopt application on the tape recorded by
+// the first call, or on the analytic derivatives. Bounds and starting point
+// are written straight into the preallocated arrays of the NLP.
+bool IpoptBackend::SolvePersistent(const VectorXd &state,
+                                   const VectorXd &coeffs, bool warm) {
+  if (!derivatives_) {
+    if (analytic_derivatives_) {
+      derivatives_.reset(new MPCAnalyticDerivatives(layout_));
+    } else {
+      std::unique_ptr<MPCTape> tape(new MPCTape);
+      FG_evalT<MPCLayout> fg_eval(layout_);
+      SparsityPattern jac, hes;
+      MPCSparsityT(layout_, jac, hes);
+      tape->Record(fg_eval, layout_.n_vars, layout_.n_constraints,
+                   coeffs.size(), &jac, &hes);
+      derivatives_ = std::move(tape);
+    }
+    ipopt_.reset(new PersistentIpopt(*derivatives_));
+  }
+  derivatives_->SetParameters(coeffs.data());
+
+  MPCNLP &nlp = ipopt_->nlp();
+  std::copy(lb.data(), lb.data() + layout_.n_vars, nlp.x_l.begin());
+  std::copy(ub.data(), ub.data() + layout_.n_vars, nlp.x_u.begin());
+  SetConstraintBoundsT(layout_, state.data(), &nlp.g_l[0], &nlp.g_u[0]);
+  if (warm) {
+    nlp.x_init = warm_x_;
+    nlp.z_L_init = warm_zl_;
+    nlp.z_U_init = warm_zu_;
+    nlp.lambda_init = warm_lambda_;
+  } else if (static_cast<size_t>(initial_guess.size()) == layout_.n_vars) {
+    std::copy(initial_guess.data(), initial_guess.data() + layout_.n_vars,
+              nlp.x_init.begin());
+  } else {
+    std::fill(nlp.x_init.begin(), nlp.x_init.end(), 0.0);
+  }
+
+  nlp.deadline = deadline;
+  // Without multipliers only the primal point is warm; Ipopt starts the
+  // multipliers and the barrier cold.
+  bool ok = ipopt_->Solve(warm && warm_multipliers_);
+  last_iterations_ = ipopt_->LastIterations();
+  deadline_hit_ = nlp.deadline_hit;
+
+  solution_ = Eigen::Map<const VectorXd>(&nlp.x_sol[0], layout_.n_vars);
+  if (ok) {
+    warm_x_ = nlp.x_sol;
+    warm_multipliers_ = !ipopt_->UsedBestIterate();
+    if (warm_multipliers_) {
+      warm_zl_ = nlp.z_L_sol;
+      warm_zu_ = nlp.z_U_sol;
+      warm_lambda_ = nlp.lambda_sol;
+    } else {
+      warm_zl_.assign(layout_.n_vars, 0.0);
+      warm_zu_.assign(layout_.n_vars, 0.0);
+      warm_lambda_.assign(layout_.n_constraints, 0.0);
+    }
+  }
+  return ok;
+}
+
+// Solve through CppAD::ipopt::solve, which retapes FG_eval and sets up a new
+// Ipopt application on every call.
+bool IpoptBackend::SolveLegacy(const VectorXd &state, const VectorXd &coeffs,
+                               bool warm) {
+  size_t n_vars = layout_.n_vars;
+  size_t n_constraints = layout_.n_constraints;
+
+  // Initial value of the independent variables.
+  // SHOULD BE 0 besides initial state, unless we warm start from the
+  // previous solution or are given an initial guess. CppAD::ipopt::solve
+  // only takes a primal starting point.
+  bool guess = !warm &&
+               static_cast<size_t>(initial_guess.size()) == n_vars;
+  Dvector vars(n_vars);
+  for (size_t i = 0; i < n_vars; ++i) {
+    vars[i] = warm ? warm_x_[i] : guess ? initial_guess[i] : 0.0;
+  }
+
+  Dvector vars_lowerbound(n_vars);
+  Dvector vars_upperbound(n_vars);
+  for (size_t i = 0; i < n_vars; ++i) {
+    vars_lowerbound[i] = lb[i];
+    vars_upperbound[i] = ub[i];
+  }
+  Dvector constraints_lowerbound(n_constraints);
+  Dvector constraints_upperbound(n_constraints);
+  SetConstraintBoundsT(layout_, state.data(), &constraints_lowerbound[0],
+                       &constraints_upperbound[0]);
+
+  // object that computes objective and constraints
+  typedef FG_evalT<MPCLayout> FG_eval;
+  FG_eval fg_eval(layout_, coeffs);
+
+  // NOTE: You don't have to worry about these options
+  // options for IPOPT solver
+  std::string options;
+  // Uncomment this if you'd like more print information
+  options += "Integer print_level  0\n";
+  // NOTE: Setting sparse to true allows the solver to take advantage
+  //   of sparse routines, this makes the computation MUCH FASTER. If you can
+  //   uncomment 1 of these and see if it makes a difference or not but if you
+  //   uncomment both the computation time should go up in orders of magnitude.
+  options += "Sparse  true        forward\n";
+  options += "Sparse  true        reverse\n";
+  // NOTE: Currently the solver has a maximum time limit of 0.5 seconds.
+  // Change this as you see fit.
+  // CppAD::ipopt::solve takes no intermediate callback, so a deadline can
+  // only shorten this CPU time limit.
+  double max_cpu_time = 0.5;
+  if (deadline.IsSet()) {
+    max_cpu_time = std::min(max_cpu_time,
+                            std::max(deadline.RemainingMs(), 1.0) / 1000.0);
+  }
+  options += "Numeric max_cpu_time          " + std::to_string(max_cpu_time) +
+             "\n";
+
+  // place to return solution
+  CppAD::ipopt::solve_result<Dvector> solution;
+
+  // solve the problem
+  CppAD::ipopt::solve<Dvector, FG_eval>(
+      options, vars, vars_lowerbound, vars_upperbound, constraints_lowerbound,
+      constraints_upperbound, fg_eval, solution);
+  last_iterations_ = -1;
+
+  // Check some of the solution values
+  bool ok = solution.status == CppAD::ipopt::solve_result<Dvector>::success;
+  deadline_hit_ = deadline.IsSet() && !ok && deadline.Near();
+
+  for (size_t i = 0; i < n_vars; ++i) {
+    solution_[i] = solution.x[i];
+  }
+  if (ok) {
+    warm_x_.resize(n_vars);
+    warm_zl_.resize(n_vars);
+    warm_zu_.resize(n_vars);
+    warm_lambda_.resize(n_constraints);
+    for (size_t i = 0; i < n_vars; ++i) {
+      warm_x_[i] = solution.x[i];
+      warm_zl_[i] = solution.zl[i];
+      warm_zu_[i] = solution.zu[i];
+    }
+    for (size_t i = 0; i < n_constraints; ++i) {
+      warm_lambda_[i] = solution.lambda[i];
+    }
+    warm_multipliers_ = true;
+  }
+  return ok;
+}
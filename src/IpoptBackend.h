@@ -0,0 +1,67 @@
+#ifndef IPOPT_BACKEND_H
+#define IPOPT_BACKEND_H
+
+#include <memory>
+#include <vector>
+#include "Eigen-3.3/Eigen/Core"
+#include "SolverBackend.h"
+
+class MPCDerivatives;
+class PersistentIpopt;
+
+//
+// The NLP of FG_evalT solved to convergence by Ipopt.
+//
+// With `persistent_tape` the CppAD tape is recorded once and solved through
+// a long-lived PersistentIpopt, warm starting primal and dual variables, and
+// a deadline stops Ipopt between iterations with the best feasible iterate.
+// Otherwise every solve goes through CppAD::ipopt::solve, which retapes and
+// sets up a new Ipopt application and only takes a primal starting point;
+// a deadline only lowers its CPU time limit.
+//
+// With `analytic_derivatives` the persistent application evaluates the NLP
+// with MPCAnalyticDerivatives instead of the tape, and CppAD is not used.
+//
+class IpoptBackend : public SolverBackend {
+ public:
+  IpoptBackend(const MPCLayout &layout, bool persistent_tape,
+               bool analytic_derivatives = false);
+  ~IpoptBackend();
+
+  const char *Name() const override {
+    return !persistent_tape_ ? "ipopt-legacy"
+           : analytic_derivatives_ ? "ipopt-analytic" : "ipopt";
+  }
+  void ResetWarmStart() override { warm_x_.clear(); }
+  const Eigen::VectorXd &Solution() const override { return solution_; }
+
+ protected:
+  bool SolveImpl(const Eigen::VectorXd &state,
+                 const Eigen::VectorXd &coeffs) override;
+  int LastIterations() const override { return last_iterations_; }
+
+ private:
+  bool SolvePersistent(const Eigen::VectorXd &state,
+                       const Eigen::VectorXd &coeffs, bool warm);
+  bool SolveLegacy(const Eigen::VectorXd &state,
+                   const Eigen::VectorXd &coeffs, bool warm);
+
+  bool persistent_tape_;
+  bool analytic_derivatives_;
+  std::unique_ptr<MPCDerivatives> derivatives_;
+  std::unique_ptr<PersistentIpopt> ipopt_;
+
+  Eigen::VectorXd solution_;
+  int last_iterations_ = -1;
+
+  // Previous solution and multipliers (bounds, constraints). The
+  // multipliers are unset (zero) after a solve that returned its best
+  // iterate on the deadline, as Ipopt only reports those of the last one.
+  std::vector<double> warm_x_;
+  std::vector<double> warm_zl_;
+  std::vector<double> warm_zu_;
+  std::vector<double> warm_lambda_;
+  bool warm_multipliers_ = false;
+};
+
+#endif  // IPOPT_BACKEND_H
@@ -1,8 +1,13 @@
 #ifndef MPC_H
 #define MPC_H
 
+#include <memory>
+#include <string>
 #include <vector>
 #include "Eigen-3.3/Eigen/Core"
+#include "HorizonScheduler.h"
+#include "SolutionCache.h"
+#include "SolverBackend.h"
 
 class MPC {
  public:
@@ -15,9 +20,105 @@ class MPC {
   std::vector<double> Solve(const Eigen::VectorXd &state, 
                             const Eigen::VectorXd &coeffs);
 
+  // Select the solver backend by name (see SolverBackendNames()). Returns
+  // false, keeping the current backend, for an unknown name. The default
+  // is "ipopt".
+  bool SetSolver(const std::string &name);
+  const std::string &SolverName() const { return solver_name_; }
+  const MPCLayout &Layout() const { return backend_->Layout(); }
+
+  // Hold the actuations constant over blocks of steps, e.g. {1, 1, 2, 2, 3}
+  // (see MPCLayout); empty for a move per step. Replaces the backend by a
+  // new one of the same name. Returns false, keeping the current layout,
+  // if the backend does not support move blocking.
+  bool SetMoveBlocks(const std::vector<size_t> &blocks);
+  const std::vector<size_t> &MoveBlocks() const { return move_blocks_; }
+
+  // Non-uniform time grid of the sizes of the N - 1 steps (see MPCLayout),
+  // e.g. short steps for the near term and long ones for the lookahead;
+  // empty for the default of N = 10, dt = 0.1. Replaces the backend by a
+  // new one of the same name. Returns false, keeping the current grid, for
+  // a step size that is not positive and while horizons are set, whose
+  // grids are uniform.
+  bool SetStepSizes(const std::vector<double> &dts);
+  const std::vector<double> &StepSizes() const { return step_sizes_; }
+
+  // Choose the horizon of every solve among options.horizons by speed and
+  // recent solve times (see HorizonScheduler); no horizons for the fixed
+  // grid of SetStepSizes(). Builds a backend per horizon up front and
+  // solves once with each, so switching is only a pointer change; the
+  // backend switched to starts cold. Returns false, keeping the current
+  // horizons, if the backend does not support one of them or a grid of
+  // SetStepSizes() is set.
+  bool SetHorizons(const HorizonScheduler::Options &options);
+  const HorizonScheduler &Scheduler() const { return scheduler_; }
+
+  // SetSolver(), SetMoveBlocks(), SetStepSizes() and SetHorizons() at
+  // once, building the backends a single time. Returns false, keeping the
+  // current configuration, if one of them would.
+  bool Configure(const std::string &name, const std::vector<size_t> &blocks,
+                 const std::vector<double> &dts,
+                 const HorizonScheduler::Options &options);
+
+  // Layouts of the backends of a configuration, one per horizon.
+  static std::vector<MPCLayout> Layouts(
+      const std::vector<size_t> &blocks, const std::vector<double> &dts,
+      const HorizonScheduler::Options &options);
+
+  // Whether Configure() accepts a configuration, checked without building
+  // any backend; building may still run out of threads.
+  static bool Supports(const std::string &name,
+                       const std::vector<size_t> &blocks,
+                       const std::vector<double> &dts,
+                       const HorizonScheduler::Options &options);
+
+  // Work of the backend for the next frame, to be called after the
+  // actuation was sent and before the next telemetry. None after a plan
+  // returned by the cache.
+  void Prepare();
+
+  // Statistics of the current backend, i.e. of the current horizon.
+  const SolverStats &Stats() const { return backend_->Stats(); }
+
   double prevDelta = 0.0;
   double prevA     = 0.0;
-  
+
+  // Start each solve from the previous solution, shifted one step forward.
+  bool use_warm_start = true;
+
+  // Print cost and solve time of every solve.
+  bool verbose = true;
+
+  // Solutions of earlier solves for nearly the same inputs; disabled
+  // unless configured.
+  SolutionCache cache;
+
+  // Wall-clock deadline of the next Solve(), e.g. derived from the arrival
+  // of the telemetry. The backend returns its best plan by then.
+  Deadline deadline;
+
+ private:
+  void SetBounds(const Eigen::VectorXd &state, double *vars_lowerbound,
+                 double *vars_upperbound);
+
+  // Replace the backends by ones of backend `name` for move blocking
+  // `blocks` and the horizons of `options`, or else the grid `dts`, and
+  // solve once with each, so that the first frame does not record tapes
+  // or set up solvers.
+  bool MakeBackends(const std::string &name,
+                    const std::vector<size_t> &blocks,
+                    const std::vector<double> &dts,
+                    const HorizonScheduler::Options &options);
+
+  // A backend per horizon of the scheduler, and the current one.
+  std::vector<std::unique_ptr<SolverBackend> > backends_;
+  SolverBackend *backend_ = nullptr;
+  std::string solver_name_;
+  std::vector<size_t> move_blocks_;
+  std::vector<double> step_sizes_;
+  HorizonScheduler scheduler_;
+  // The last Solve() returned a cached plan without solving.
+  bool plan_cached_ = false;
 };
 
 #endif  // MPC_H
@@ -0,0 +1,252 @@
+#include "MPCAnalyticDerivatives.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <utility>
+
+namespace {
+
+// (state, column of [A B]) of the structural nonzeros of ModelJacobian(),
+// column 6 the steering and 7 the acceleration.
+const int kModelEntries[MPCAnalyticDerivatives::kNumModelEntries][2] = {
+    {kX, kX},       {kX, kPsi},   {kX, kV},                       // x
+    {kY, kY},       {kY, kPsi},   {kY, kV},                       // y
+    {kPsi, kPsi},   {kPsi, kV},   {kPsi, 6},                      // psi
+    {kV, kV},       {kV, 7},                                      // v
+    {kCte, kX},     {kCte, kY},   {kCte, kV},   {kCte, kEpsi},    // cte
+    {kEpsi, kX},    {kEpsi, kPsi}, {kEpsi, kV}, {kEpsi, 6},       // epsi
+};
+
+// Sorted, unique (row, column) entries of `pattern` with both below the
+// given limits, rows shifted by `row_offset`.
+void SelectEntries(const SparsityPattern &pattern, size_t row_offset,
+                   size_t n_rows, size_t n_cols, std::vector<size_t> &rows,
+                   std::vector<size_t> &cols) {
+  SparsityPattern entries;
+  for (const std::pair<size_t, size_t> &e : pattern) {
+    if (e.first >= row_offset && e.first - row_offset < n_rows &&
+        e.second < n_cols) {
+      entries.push_back(std::make_pair(e.first - row_offset, e.second));
+    }
+  }
+  std::sort(entries.begin(), entries.end());
+  entries.erase(std::unique(entries.begin(), entries.end()), entries.end());
+  rows.clear();
+  cols.clear();
+  for (const std::pair<size_t, size_t> &e : entries) {
+    rows.push_back(e.first);
+    cols.push_back(e.second);
+  }
+}
+
+}  // namespace
+
+MPCAnalyticDerivatives::MPCAnalyticDerivatives(const MPCLayout &layout)
+    : layout_(layout) {
+  const MPCLayout &l = layout_;
+  const size_t N = l.N;
+  SparsityPattern jac, hes;
+  MPCSparsityT(l, jac, hes);
+  // Constraint rows are the rows of fg after the cost.
+  SelectEntries(jac, 1, l.n_constraints, l.n_vars, jac_rows_, jac_cols_);
+  SelectEntries(hes, 0, l.n_vars, l.n_vars, hes_rows_, hes_cols_);
+
+  for (size_t k = 0; k < 6; ++k) {
+    jac_initial_[k] =
+        Find(jac_rows_, jac_cols_, l.StateStart(k), l.StateStart(k));
+  }
+
+  steps_.resize(N - 1);
+  for (size_t t = 0; t + 1 < N; ++t) {
+    Step &step = steps_[t];
+    const size_t delta = l.delta_start + l.Move(t);
+    const size_t a = l.a_start + l.Move(t);
+    const size_t columns[] = {l.StateStart(kX) + t,   l.StateStart(kY) + t,
+                              l.StateStart(kPsi) + t, l.StateStart(kV) + t,
+                              l.StateStart(kCte) + t, l.StateStart(kEpsi) + t,
+                              delta,                  a};
+    for (size_t k = 0; k < 6; ++k) {
+      step.jac[k] = Find(jac_rows_, jac_cols_, l.StateStart(k) + t + 1,
+                         l.StateStart(k) + t + 1);
+    }
+    for (int e = 0; e < kNumModelEntries; ++e) {
+      step.jac[6 + e] = Find(jac_rows_, jac_cols_,
+                             l.StateStart(kModelEntries[e][0]) + t + 1,
+                             columns[kModelEntries[e][1]]);
+    }
+
+    const size_t x = columns[kX], psi = columns[kPsi], v = columns[kV];
+    const size_t epsi = columns[kEpsi];
+    step.hes_model[0] = Find(hes_rows_, hes_cols_, psi, psi);
+    step.hes_model[1] = Find(hes_rows_, hes_cols_, v, psi);
+    step.hes_model[2] = Find(hes_rows_, hes_cols_, delta, v);
+    step.hes_model[3] = Find(hes_rows_, hes_cols_, epsi, epsi);
+    step.hes_model[4] = Find(hes_rows_, hes_cols_, epsi, v);
+    step.hes_model[5] = Find(hes_rows_, hes_cols_, x, x);
+
+    step.hes_moves[0] = Find(hes_rows_, hes_cols_, delta, delta);
+    step.hes_moves[1] = Find(hes_rows_, hes_cols_, a, a);
+    if (t + 2 < N && l.Move(t + 1) != l.Move(t)) {
+      step.hes_rates[0] = Find(hes_rows_, hes_cols_,
+                               l.delta_start + l.Move(t + 1), delta);
+      step.hes_rates[1] = Find(hes_rows_, hes_cols_,
+                               l.a_start + l.Move(t + 1), a);
+    } else {
+      step.hes_rates[0] = step.hes_rates[1] = 0;
+    }
+  }
+
+  hes_states_.resize(3 * N);
+  for (size_t t = 0; t < N; ++t) {
+    const size_t vars[] = {l.v_start + t, l.cte_start + t, l.epsi_start + t};
+    for (size_t i = 0; i < 3; ++i) {
+      hes_states_[3 * t + i] = Find(hes_rows_, hes_cols_, vars[i], vars[i]);
+    }
+  }
+}
+
+size_t MPCAnalyticDerivatives::Find(const std::vector<size_t> &rows,
+                                    const std::vector<size_t> &cols,
+                                    size_t row, size_t col) {
+  // Entries are sorted by row, then column.
+  size_t lo = std::lower_bound(rows.begin(), rows.end(), row) - rows.begin();
+  size_t hi = std::upper_bound(rows.begin(), rows.end(), row) - rows.begin();
+  size_t k = std::lower_bound(cols.begin() + lo, cols.begin() + hi, col) -
+             cols.begin();
+  assert(k < hi && cols[k] == col);
+  return k;
+}
+
+void MPCAnalyticDerivatives::SetParameters(const double* params) {
+  std::copy(params, params + 4, coeffs_);
+}
+
+double MPCAnalyticDerivatives::EvalF(const double* x) {
+  return MPCCost(layout_, x);
+}
+
+void MPCAnalyticDerivatives::EvalG(const double* x, double* g) {
+  const MPCLayout &l = layout_;
+  for (size_t k = 0; k < 6; ++k) {
+    g[l.StateStart(k)] = x[l.StateStart(k)];
+  }
+  for (size_t t = 0; t + 1 < l.N; ++t) {
+    Vector6d s1 = StateAt(l, x, t + 1) -
+                  ModelStep(StateAt(l, x, t), x[l.delta_start + l.Move(t)],
+                            x[l.a_start + l.Move(t)], coeffs_, l.Dt(t));
+    SetStateAt(l, s1, t + 1, g);
+  }
+}
+
+void MPCAnalyticDerivatives::EvalGradF(const double* x, double* grad_f) {
+  const MPCLayout &l = layout_;
+  std::fill(grad_f, grad_f + l.n_vars, 0.0);
+  for (size_t t = 0; t < l.N; ++t) {
+    grad_f[l.cte_start + t] = 2.0 * w_cte * x[l.cte_start + t];
+    grad_f[l.epsi_start + t] = 2.0 * w_epsi * x[l.epsi_start + t];
+    grad_f[l.v_start + t] = 2.0 * w_v * (x[l.v_start + t] - ref_v);
+  }
+  for (size_t t = 0; t + 1 < l.N; ++t) {
+    const size_t delta = l.delta_start + l.Move(t);
+    const size_t a = l.a_start + l.Move(t);
+    grad_f[delta] += 2.0 * w_delta * x[delta];
+    grad_f[a] += 2.0 * w_a * x[a];
+    if (t + 2 < l.N && l.Move(t + 1) != l.Move(t)) {
+      const size_t delta1 = l.delta_start + l.Move(t + 1);
+      const size_t a1 = l.a_start + l.Move(t + 1);
+      const double ddelta = 2.0 * w_ddelta * (x[delta1] - x[delta]);
+      const double da = 2.0 * w_da * (x[a1] - x[a]);
+      grad_f[delta1] += ddelta;
+      grad_f[delta] -= ddelta;
+      grad_f[a1] += da;
+      grad_f[a] -= da;
+    }
+  }
+}
+
+void MPCAnalyticDerivatives::EvalJacG(const double* x, double* values) {
+  const MPCLayout &l = layout_;
+  for (size_t k = 0; k < 6; ++k) {
+    values[jac_initial_[k]] = 1.0;
+  }
+  Matrix6d A;
+  Matrix62d B;
+  for (size_t t = 0; t + 1 < l.N; ++t) {
+    const Step &step = steps_[t];
+    ModelJacobian(StateAt(l, x, t), x[l.delta_start + l.Move(t)],
+                  x[l.a_start + l.Move(t)], coeffs_, l.Dt(t), A, B);
+    // The constraints are s_{t+1} - f(s_t, u_t).
+    for (size_t k = 0; k < 6; ++k) {
+      values[step.jac[k]] = 1.0;
+    }
+    for (int e = 0; e < kNumModelEntries; ++e) {
+      const int row = kModelEntries[e][0], col = kModelEntries[e][1];
+      values[step.jac[6 + e]] = col < 6 ? -A(row, col) : -B(row, col - 6);
+    }
+  }
+}
+
+void MPCAnalyticDerivatives::EvalHesLag(const double* x, double obj_factor,
+                                        const double* lambda,
+                                        double* values) {
+  const MPCLayout &l = layout_;
+  const double *c = coeffs_;
+  std::fill(values, values + hes_rows_.size(), 0.0);
+
+  // Cost.
+  for (size_t t = 0; t < l.N; ++t) {
+    values[hes_states_[3 * t]] += obj_factor * 2.0 * w_v;
+    values[hes_states_[3 * t + 1]] += obj_factor * 2.0 * w_cte;
+    values[hes_states_[3 * t + 2]] += obj_factor * 2.0 * w_epsi;
+  }
+  for (size_t t = 0; t + 1 < l.N; ++t) {
+    const Step &step = steps_[t];
+    values[step.hes_moves[0]] += obj_factor * 2.0 * w_delta;
+    values[step.hes_moves[1]] += obj_factor * 2.0 * w_a;
+    if (t + 2 < l.N && l.Move(t + 1) != l.Move(t)) {
+      values[step.hes_moves[0]] += obj_factor * 2.0 * w_ddelta;
+      values[step.hes_moves[1]] += obj_factor * 2.0 * w_da;
+      values[steps_[t + 1].hes_moves[0]] += obj_factor * 2.0 * w_ddelta;
+      values[steps_[t + 1].hes_moves[1]] += obj_factor * 2.0 * w_da;
+      values[step.hes_rates[0]] -= obj_factor * 2.0 * w_ddelta;
+      values[step.hes_rates[1]] -= obj_factor * 2.0 * w_da;
+    }
+  }
+
+  // Constraints s_{t+1} - f(s_t, u_t): minus the second derivatives of the
+  // model, weighted by the multipliers of step t + 1.
+  for (size_t t = 0; t + 1 < l.N; ++t) {
+    const Step &step = steps_[t];
+    const double dt = l.Dt(t);
+    const double x0 = x[l.x_start + t];
+    const double psi0 = x[l.psi_start + t];
+    const double v0 = x[l.v_start + t];
+    const double epsi0 = x[l.epsi_start + t];
+    const double lx = lambda[l.x_start + t + 1];
+    const double ly = lambda[l.y_start + t + 1];
+    const double lpsi = lambda[l.psi_start + t + 1];
+    const double lcte = lambda[l.cte_start + t + 1];
+    const double lepsi = lambda[l.epsi_start + t + 1];
+
+    // f'(x0), f''(x0) and f'''(x0) of the polynomial, and the second
+    // derivative of atan(f'(x0)).
+    const double df0 = c[1] + 2.0 * c[2] * x0 + 3.0 * c[3] * x0 * x0;
+    const double ddf0 = 2.0 * c[2] + 6.0 * c[3] * x0;
+    const double dddf0 = 6.0 * c[3];
+    const double q = 1.0 + df0 * df0;
+    const double ddpsides0 = dddf0 / q - 2.0 * df0 * ddf0 * ddf0 / (q * q);
+
+    const double cos_psi = std::cos(psi0), sin_psi = std::sin(psi0);
+    const double cos_epsi = std::cos(epsi0), sin_epsi = std::sin(epsi0);
+    // x: v0 cos(psi0) dt, y: v0 sin(psi0) dt.
+    values[step.hes_model[0]] += (lx * cos_psi + ly * sin_psi) * v0 * dt;
+    values[step.hes_model[1]] += (lx * sin_psi - ly * cos_psi) * dt;
+    // psi and epsi: v0 / Lf * delta0 * dt.
+    values[step.hes_model[2]] -= (lpsi + lepsi) * dt / Lf;
+    // cte: f(x0) + v0 sin(epsi0) dt.
+    values[step.hes_model[3]] += lcte * v0 * sin_epsi * dt;
+    values[step.hes_model[4]] -= lcte * cos_epsi * dt;
+    // cte: f(x0), epsi: -atan(f'(x0)).
+    values[step.hes_model[5]] += lepsi * ddpsides0 - lcte * ddf0;
+  }
+}
@@ -0,0 +1,81 @@
+#ifndef MPC_ANALYTIC_DERIVATIVES_H
+#define MPC_ANALYTIC_DERIVATIVES_H
+
+#include <vector>
+#include "MPCDerivatives.h"
+#include "MPCProblem.h"
+
+//
+// Derivatives of the MPC NLP of FG_evalT in closed form, without CppAD.
+//
+// Cost and constraints come from MPCCost() and ModelStep(), the Jacobian
+// from ModelJacobian(), and the second derivatives of the kinematic model
+// are written out in EvalHesLag(). The entries are those of MPCSparsityT()
+// with respect to the variables, in the same order as MPCTape with these
+// patterns, so the values of both can be compared one by one. Where every
+// value goes is worked out once in the constructor; an evaluation is a
+// single pass over the steps that writes into the caller's arrays.
+//
+// The only parameters are the 4 polynomial coefficients.
+//
+class MPCAnalyticDerivatives : public MPCDerivatives {
+ public:
+  explicit MPCAnalyticDerivatives(const MPCLayout &layout);
+
+  size_t NumVars() const override { return layout_.n_vars; }
+  size_t NumConstraints() const override { return layout_.n_constraints; }
+
+  void SetParameters(const double* params) override;
+
+  double EvalF(const double* x) override;
+  void EvalG(const double* x, double* g) override;
+  void EvalGradF(const double* x, double* grad_f) override;
+  void EvalJacG(const double* x, double* values) override;
+  void EvalHesLag(const double* x, double obj_factor, const double* lambda,
+                  double* values) override;
+
+  const std::vector<size_t>& JacRows() const override { return jac_rows_; }
+  const std::vector<size_t>& JacCols() const override { return jac_cols_; }
+  const std::vector<size_t>& HesRows() const override { return hes_rows_; }
+  const std::vector<size_t>& HesCols() const override { return hes_cols_; }
+
+  // Structurally nonzero entries (state, column of [A B]) of the model
+  // Jacobians of ModelJacobian().
+  static const int kNumModelEntries = 19;
+
+ private:
+  // Positions in the values of EvalJacG() and EvalHesLag() of the entries
+  // of the model step t, from step t to step t + 1, and of its actuations.
+  struct Step {
+    // Jacobian of the constraints of step t + 1: the states of step t + 1,
+    // then the model entries.
+    size_t jac[6 + kNumModelEntries];
+    // Hessian of the constraints of step t + 1: (psi, psi), (v, psi),
+    // (delta, v), (epsi, epsi), (epsi, v) and (x, x) of step t.
+    size_t hes_model[6];
+    // Hessian of the cost: (delta, delta) and (a, a) of the move of step t,
+    // and (delta, delta) and (a, a) between it and the move of step t + 1.
+    size_t hes_moves[2];
+    size_t hes_rates[2];
+  };
+
+  // Position of the entry (row, col) of the patterns.
+  static size_t Find(const std::vector<size_t> &rows,
+                     const std::vector<size_t> &cols, size_t row, size_t col);
+
+  MPCLayout layout_;
+  double coeffs_[4] = {0.0, 0.0, 0.0, 0.0};
+
+  std::vector<size_t> jac_rows_;
+  std::vector<size_t> jac_cols_;
+  std::vector<size_t> hes_rows_;
+  std::vector<size_t> hes_cols_;
+
+  // Jacobian entries of the initial state constraints.
+  size_t jac_initial_[6];
+  std::vector<Step> steps_;
+  // Hessian entries (v, v), (cte, cte) and (epsi, epsi) of every state.
+  std::vector<size_t> hes_states_;
+};
+
+#endif  // MPC_ANALYTIC_DERIVATIVES_H
@@ -0,0 +1,62 @@
+#ifndef MPC_AUTO_DIFF_H
+#define MPC_AUTO_DIFF_H
+
+#include <cmath>
+#include "Eigen-3.3/Eigen/Core"
+#include "Eigen-3.3/unsupported/Eigen/AutoDiff"
+#include "MPCProblem.h"
+
+//
+// Forward mode automatic differentiation of the templated model and cost
+// of MPCProblem.h with Eigen::AutoDiffScalar, without a tape.
+//
+
+namespace Eigen {
+
+// atan of AutoDiffScalar, which Eigen 3.3 lacks and ModelStepT() needs.
+// Found by argument dependent lookup like the sin and cos of AutoDiff.
+template <typename DerType>
+inline const AutoDiffScalar<EIGEN_EXPR_BINARYOP_SCALAR_RETURN_TYPE(
+    typename internal::remove_all<DerType>::type,
+    typename internal::traits<
+        typename internal::remove_all<DerType>::type>::Scalar,
+    product)>
+atan(const AutoDiffScalar<DerType> &x) {
+  using std::atan;
+  typedef typename internal::traits<
+      typename internal::remove_all<DerType>::type>::Scalar Scalar;
+  return MakeAutoDiffScalar(
+      atan(x.value()),
+      x.derivatives() * (Scalar(1) / (Scalar(1) + x.value() * x.value())));
+}
+
+}  // namespace Eigen
+
+// Dual number of the 8 inputs of a model step, the state and the two
+// actuations. The derivatives are a fixed-size vector, so evaluating in it
+// allocates nothing and is inlined like plain double code.
+typedef Eigen::AutoDiffScalar<Eigen::Matrix<double, 8, 1> > StageDual;
+
+// Jacobians A = df/ds0 and B = df/d(delta0, a0) of ModelStep(), as
+// ModelJacobian(), by a single evaluation of ModelStepT() in StageDual.
+// The value of the step comes with them and is written into `s1` unless
+// it is null.
+inline void ModelJacobianDual(const Vector6d &s0, double delta0, double a0,
+                              const double *coeffs, double dt, Matrix6d &A,
+                              Matrix62d &B, Vector6d *s1 = NULL) {
+  StageDual in[6], out[6];
+  for (int i = 0; i < 6; ++i) {
+    in[i] = StageDual(s0[i], 8, i);
+  }
+  ModelStepT(in, StageDual(delta0, 8, 6), StageDual(a0, 8, 7), coeffs, dt,
+             out);
+  for (int i = 0; i < 6; ++i) {
+    A.row(i) = out[i].derivatives().head<6>().transpose();
+    B.row(i) = out[i].derivatives().tail<2>().transpose();
+    if (s1 != NULL) {
+      (*s1)[i] = out[i].value();
+    }
+  }
+}
+
+#endif  // MPC_AUTO_DIFF_H
@@ -0,0 +1,43 @@
+#ifndef MPC_DERIVATIVES_H
+#define MPC_DERIVATIVES_H
+
+#include <cstddef>
+#include <vector>
+
+//
+// Cost, constraints and their derivatives of the MPC NLP of FG_evalT, as
+// needed by an NLP solver, for variables in the order of the layout and
+// the problem parameters (the fitted polynomial coefficients) held fixed.
+//
+// Implemented by MPCTape on a CppAD tape and by MPCAnalyticDerivatives in
+// closed form.
+//
+class MPCDerivatives {
+ public:
+  virtual ~MPCDerivatives() {}
+
+  virtual size_t NumVars() const = 0;
+  virtual size_t NumConstraints() const = 0;
+
+  // Set the parameter values used by all following evaluations.
+  virtual void SetParameters(const double* params) = 0;
+
+  // Cost and constraints at `x`.
+  virtual double EvalF(const double* x) = 0;
+  virtual void EvalG(const double* x, double* g) = 0;
+  virtual void EvalGradF(const double* x, double* grad_f) = 0;
+
+  // Sparse Jacobian of the constraints and sparse lower triangle of the
+  // Hessian of the Lagrangian, in the order of JacRows()/JacCols() and
+  // HesRows()/HesCols() (row and column indices relative to vars and g).
+  virtual void EvalJacG(const double* x, double* values) = 0;
+  virtual void EvalHesLag(const double* x, double obj_factor,
+                          const double* lambda, double* values) = 0;
+
+  virtual const std::vector<size_t>& JacRows() const = 0;
+  virtual const std::vector<size_t>& JacCols() const = 0;
+  virtual const std::vector<size_t>& HesRows() const = 0;
+  virtual const std::vector<size_t>& HesCols() const = 0;
+};
+
+#endif  // MPC_DERIVATIVES_H
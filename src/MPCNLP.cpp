@@ -0,0 +1,256 @@
+#include "MPCNLP.h"
+#include <coin/IpIpoptCalculatedQuantities.hpp>
+#include <coin/IpIpoptData.hpp>
+#include <coin/IpOrigIpoptNLP.hpp>
+#include <coin/IpTNLPAdapter.hpp>
+
+MPCNLP::MPCNLP(MPCDerivatives &derivatives)
+    : derivatives_(derivatives) {
+  size_t n = derivatives_.NumVars();
+  size_t m = derivatives_.NumConstraints();
+  x_l.assign(n, -1.0e19);
+  x_u.assign(n, 1.0e19);
+  g_l.assign(m, 0.0);
+  g_u.assign(m, 0.0);
+  x_init.assign(n, 0.0);
+  z_L_init.assign(n, 0.0);
+  z_U_init.assign(n, 0.0);
+  lambda_init.assign(m, 0.0);
+  x_sol.assign(n, 0.0);
+  z_L_sol.assign(n, 0.0);
+  z_U_sol.assign(n, 0.0);
+  lambda_sol.assign(m, 0.0);
+  x_best.assign(n, 0.0);
+}
+
+void MPCNLP::BeginSolve() {
+  deadline_hit = false;
+  has_best = false;
+  solve_start_ = Deadline::Clock::now();
+}
+
+bool MPCNLP::get_nlp_info(Index &n, Index &m, Index &nnz_jac_g,
+                          Index &nnz_h_lag, IndexStyleEnum &index_style) {
+  n = derivatives_.NumVars();
+  m = derivatives_.NumConstraints();
+  nnz_jac_g = derivatives_.JacRows().size();
+  nnz_h_lag = derivatives_.HesRows().size();
+  index_style = C_STYLE;
+  return true;
+}
+
+bool MPCNLP::get_bounds_info(Index n, Number *x_l, Number *x_u, Index m,
+                             Number *g_l, Number *g_u) {
+  for (Index i = 0; i < n; ++i) {
+    x_l[i] = this->x_l[i];
+    x_u[i] = this->x_u[i];
+  }
+  for (Index i = 0; i < m; ++i) {
+    g_l[i] = this->g_l[i];
+    g_u[i] = this->g_u[i];
+  }
+  return true;
+}
+
+bool MPCNLP::get_starting_point(Index n, bool init_x, Number *x, bool init_z,
+                                Number *z_L, Number *z_U, Index m,
+                                bool init_lambda, Number *lambda) {
+  if ((init_z || init_lambda) && !warm_start) {
+    return false;
+  }
+  if (init_x) {
+    for (Index i = 0; i < n; ++i) {
+      x[i] = x_init[i];
+    }
+  }
+  if (init_z) {
+    for (Index i = 0; i < n; ++i) {
+      z_L[i] = z_L_init[i];
+      z_U[i] = z_U_init[i];
+    }
+  }
+  if (init_lambda) {
+    for (Index i = 0; i < m; ++i) {
+      lambda[i] = lambda_init[i];
+    }
+  }
+  return true;
+}
+
+bool MPCNLP::eval_f(Index n, const Number *x, bool new_x, Number &obj_value) {
+  obj_value = derivatives_.EvalF(x);
+  return true;
+}
+
+bool MPCNLP::eval_grad_f(Index n, const Number *x, bool new_x,
+                         Number *grad_f) {
+  derivatives_.EvalGradF(x, grad_f);
+  return true;
+}
+
+bool MPCNLP::eval_g(Index n, const Number *x, bool new_x, Index m,
+                    Number *g) {
+  derivatives_.EvalG(x, g);
+  return true;
+}
+
+bool MPCNLP::eval_jac_g(Index n, const Number *x, bool new_x, Index m,
+                        Index nele_jac, Index *iRow, Index *jCol,
+                        Number *values) {
+  if (values == NULL) {
+    const std::vector<size_t> &rows = derivatives_.JacRows();
+    const std::vector<size_t> &cols = derivatives_.JacCols();
+    for (Index k = 0; k < nele_jac; ++k) {
+      iRow[k] = rows[k];
+      jCol[k] = cols[k];
+    }
+  } else {
+    derivatives_.EvalJacG(x, values);
+  }
+  return true;
+}
+
+bool MPCNLP::eval_h(Index n, const Number *x, bool new_x, Number obj_factor,
+                    Index m, const Number *lambda, bool new_lambda,
+                    Index nele_hess, Index *iRow, Index *jCol,
+                    Number *values) {
+  if (values == NULL) {
+    const std::vector<size_t> &rows = derivatives_.HesRows();
+    const std::vector<size_t> &cols = derivatives_.HesCols();
+    for (Index k = 0; k < nele_hess; ++k) {
+      iRow[k] = rows[k];
+      jCol[k] = cols[k];
+    }
+  } else {
+    derivatives_.EvalHesLag(x, obj_factor, lambda, values);
+  }
+  return true;
+}
+
+void MPCNLP::finalize_solution(Ipopt::SolverReturn status, Index n,
+                               const Number *x, const Number *z_L,
+                               const Number *z_U, Index m, const Number *g,
+                               const Number *lambda, Number obj_value,
+                               const Ipopt::IpoptData *ip_data,
+                               Ipopt::IpoptCalculatedQuantities *ip_cq) {
+  this->status = status;
+  this->obj_value = obj_value;
+  for (Index i = 0; i < n; ++i) {
+    x_sol[i] = x[i];
+    z_L_sol[i] = z_L[i];
+    z_U_sol[i] = z_U[i];
+  }
+  for (Index i = 0; i < m; ++i) {
+    lambda_sol[i] = lambda[i];
+  }
+}
+
+bool MPCNLP::intermediate_callback(
+    Ipopt::AlgorithmMode mode, Index iter, Number obj_value, Number inf_pr,
+    Number inf_du, Number mu, Number d_norm, Number regularization_size,
+    Number alpha_du, Number alpha_pr, Index ls_trials,
+    const Ipopt::IpoptData *ip_data, Ipopt::IpoptCalculatedQuantities *ip_cq) {
+  if (!deadline.IsSet()) {
+    return true;
+  }
+
+  // Keep the best feasible iterate. Its x is only reachable through the
+  // adapter between the TNLP and Ipopt's internal problem, and is not the
+  // one of our problem during restoration.
+  if (mode == Ipopt::RegularMode && inf_pr <= feasibility_tol &&
+      (!has_best || obj_value < best_obj_value) && ip_data != NULL &&
+      ip_cq != NULL) {
+    Ipopt::OrigIpoptNLP *orig_nlp = dynamic_cast<Ipopt::OrigIpoptNLP *>(
+        Ipopt::GetRawPtr(ip_cq->GetIpoptNLP()));
+    Ipopt::TNLPAdapter *adapter =
+        orig_nlp == NULL ? NULL : dynamic_cast<Ipopt::TNLPAdapter *>(
+                                      Ipopt::GetRawPtr(orig_nlp->nlp()));
+    if (adapter != NULL) {
+      adapter->ResortX(*ip_data->curr()->x(), &x_best[0]);
+      best_obj_value = obj_value;
+      has_best = true;
+    }
+  }
+
+  // Stop if another iteration of the average length would not finish in
+  // time.
+  double elapsed_ms = std::chrono::duration<double, std::milli>(
+                          Deadline::Clock::now() - solve_start_)
+                          .count();
+  double iteration_ms = elapsed_ms / (iter + 1);
+  if (deadline.Near(iteration_ms + deadline_reserve_ms)) {
+    deadline_hit = true;
+    return false;
+  }
+  return true;
+}
+
+PersistentIpopt::PersistentIpopt(MPCDerivatives &derivatives) {
+  nlp_ = new MPCNLP(derivatives);
+  // As CppAD::ipopt::solve does; IpoptApplicationFactory() is declared
+  // differently across Ipopt versions.
+  app_ = new Ipopt::IpoptApplication();
+
+  // Same settings as the options string handed to CppAD::ipopt::solve.
+  app_->Options()->SetIntegerValue("print_level", 0);
+  app_->Options()->SetStringValue("sb", "yes");
+  app_->Options()->SetNumericValue("max_cpu_time", 0.5);
+  initialized_ = app_->Initialize() == Ipopt::Solve_Succeeded;
+}
+
+void PersistentIpopt::SetWarmStartOptions(bool warm_start) {
+  if (warm_start == warm_options_) {
+    return;
+  }
+  Ipopt::SmartPtr<Ipopt::OptionsList> options = app_->Options();
+  if (warm_start) {
+    // Keep the starting point close to the last optimum: small bound pushes
+    // and a small initial barrier parameter.
+    options->SetStringValue("warm_start_init_point", "yes");
+    options->SetNumericValue("warm_start_bound_push", 1.0e-6);
+    options->SetNumericValue("warm_start_slack_bound_push", 1.0e-6);
+    options->SetNumericValue("warm_start_mult_bound_push", 1.0e-6);
+    options->SetNumericValue("mu_init", 1.0e-6);
+  } else {
+    options->SetStringValue("warm_start_init_point", "no");
+    options->SetNumericValue("mu_init", 0.1);
+  }
+  warm_options_ = warm_start;
+}
+
+bool PersistentIpopt::Solve(bool warm_start) {
+  last_iterations_ = -1;
+  used_best_ = false;
+  if (!initialized_) {
+    return false;
+  }
+  nlp_->warm_start = warm_start;
+  nlp_->BeginSolve();
+  SetWarmStartOptions(warm_start);
+
+  // ReOptimizeTNLP reuses the problem structure of the previous solve.
+  Ipopt::ApplicationReturnStatus status;
+  if (solved_once_) {
+    status = app_->ReOptimizeTNLP(nlp_);
+  } else {
+    status = app_->OptimizeTNLP(nlp_);
+    solved_once_ = true;
+  }
+  Ipopt::SmartPtr<Ipopt::SolveStatistics> stats = app_->Statistics();
+  if (Ipopt::IsValid(stats)) {
+    last_iterations_ = stats->IterationCount();
+  }
+  if (status == Ipopt::Solve_Succeeded) {
+    return true;
+  }
+
+  // Stopped on the deadline: a feasible plan in time beats none.
+  if (status == Ipopt::User_Requested_Stop && nlp_->deadline_hit &&
+      nlp_->has_best) {
+    nlp_->x_sol = nlp_->x_best;
+    nlp_->obj_value = nlp_->best_obj_value;
+    used_best_ = true;
+    return true;
+  }
+  return false;
+}
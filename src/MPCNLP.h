@@ -0,0 +1,137 @@
+#ifndef MPC_NLP_H
+#define MPC_NLP_H
+
+#include <coin/IpIpoptApplication.hpp>
+#include <coin/IpTNLP.hpp>
+#include <vector>
+#include "Deadline.h"
+#include "MPCDerivatives.h"
+
+//
+// Ipopt view of the MPC problem, evaluated by MPCDerivatives, e.g. on a
+// prerecorded MPCTape.
+//
+// Bounds and the starting point are filled in by the caller before every
+// solve; the result of the last solve is left in the public members below.
+//
+// With a deadline set, intermediate_callback() stops Ipopt once the next
+// iteration is not expected to finish in time, keeping the best feasible
+// iterate seen so far in x_best.
+//
+class MPCNLP : public Ipopt::TNLP {
+ public:
+  typedef Ipopt::Index Index;
+  typedef Ipopt::Number Number;
+
+  explicit MPCNLP(MPCDerivatives &derivatives);
+
+  // Problem data, sized from the derivatives.
+  std::vector<double> x_l, x_u;
+  std::vector<double> g_l, g_u;
+  std::vector<double> x_init;
+
+  // Multipliers to start from when warm_start is set.
+  bool warm_start = false;
+  std::vector<double> z_L_init, z_U_init;
+  std::vector<double> lambda_init;
+
+  // Solution of the last solve.
+  std::vector<double> x_sol;
+  std::vector<double> z_L_sol, z_U_sol;
+  std::vector<double> lambda_sol;
+  double obj_value = 0.0;
+  Ipopt::SolverReturn status = Ipopt::UNASSIGNED;
+
+  // Wall-clock deadline of the next solve, with the time reserved for
+  // stopping and returning.
+  Deadline deadline;
+  double deadline_reserve_ms = 1.0;
+  // Constraint violation below which an iterate counts as feasible.
+  double feasibility_tol = 1.0e-4;
+
+  // Set by the last solve: whether it was stopped by the deadline, and the
+  // best feasible iterate (lowest cost) if there was one.
+  bool deadline_hit = false;
+  bool has_best = false;
+  std::vector<double> x_best;
+  double best_obj_value = 0.0;
+
+  // Reset the per-solve state above; called before every solve.
+  void BeginSolve();
+
+  bool get_nlp_info(Index &n, Index &m, Index &nnz_jac_g, Index &nnz_h_lag,
+                    IndexStyleEnum &index_style) override;
+  bool get_bounds_info(Index n, Number *x_l, Number *x_u, Index m,
+                       Number *g_l, Number *g_u) override;
+  bool get_starting_point(Index n, bool init_x, Number *x, bool init_z,
+                          Number *z_L, Number *z_U, Index m, bool init_lambda,
+                          Number *lambda) override;
+  bool eval_f(Index n, const Number *x, bool new_x,
+              Number &obj_value) override;
+  bool eval_grad_f(Index n, const Number *x, bool new_x,
+                   Number *grad_f) override;
+  bool eval_g(Index n, const Number *x, bool new_x, Index m,
+              Number *g) override;
+  bool eval_jac_g(Index n, const Number *x, bool new_x, Index m,
+                  Index nele_jac, Index *iRow, Index *jCol,
+                  Number *values) override;
+  bool eval_h(Index n, const Number *x, bool new_x, Number obj_factor,
+              Index m, const Number *lambda, bool new_lambda,
+              Index nele_hess, Index *iRow, Index *jCol,
+              Number *values) override;
+  void finalize_solution(Ipopt::SolverReturn status, Index n,
+                         const Number *x, const Number *z_L,
+                         const Number *z_U, Index m, const Number *g,
+                         const Number *lambda, Number obj_value,
+                         const Ipopt::IpoptData *ip_data,
+                         Ipopt::IpoptCalculatedQuantities *ip_cq) override;
+  bool intermediate_callback(Ipopt::AlgorithmMode mode, Index iter,
+                             Number obj_value, Number inf_pr, Number inf_du,
+                             Number mu, Number d_norm,
+                             Number regularization_size, Number alpha_du,
+                             Number alpha_pr, Index ls_trials,
+                             const Ipopt::IpoptData *ip_data,
+                             Ipopt::IpoptCalculatedQuantities *ip_cq) override;
+
+ private:
+  MPCDerivatives &derivatives_;
+  Deadline::Clock::time_point solve_start_;
+};
+
+//
+// Long-lived Ipopt application bound to one MPCNLP.
+//
+// Options are set and the application is initialized once. Every frame the
+// caller updates the NLP arrays (and the parameters of the derivatives) in
+// place and Solve() runs ReOptimizeTNLP, so no application, adapter or
+// problem arrays are rebuilt in the control loop.
+//
+class PersistentIpopt {
+ public:
+  explicit PersistentIpopt(MPCDerivatives &derivatives);
+
+  MPCNLP &nlp() { return *nlp_; }
+
+  // Solve from the data currently stored in nlp(). With `warm_start` the
+  // multipliers in nlp() are used as well. Returns true on success.
+  bool Solve(bool warm_start);
+
+  // Whether the last Solve() ended on the deadline of nlp() with a
+  // feasible iterate, now in nlp().x_sol.
+  bool UsedBestIterate() const { return used_best_; }
+
+  int LastIterations() const { return last_iterations_; }
+
+ private:
+  void SetWarmStartOptions(bool warm_start);
+
+  Ipopt::SmartPtr<MPCNLP> nlp_;
+  Ipopt::SmartPtr<Ipopt::IpoptApplication> app_;
+  bool initialized_ = false;
+  bool solved_once_ = false;
+  bool warm_options_ = false;
+  int last_iterations_ = -1;
+  bool used_best_ = false;
+};
+
+#endif  // MPC_NLP_H
@@ -0,0 +1,529 @@
+#ifndef MPC_PROBLEM_H
+#define MPC_PROBLEM_H
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <utility>
+#include <vector>
+#include "Eigen-3.3/Eigen/Core"
+
+//
+// Definition of the MPC problem shared by all solver paths: constants, the
+// layout of the optimizer variables, the kinematic model and the cost terms
+// for any scalar type, the bounds and the warm start shift. The CppAD
+// version of cost and constraints is FG_evalT in FG_eval.h;
+// MPCAnalyticDerivatives has their derivatives in closed form.
+//
+
+// This value assumes the model presented in the classroom is used.
+//
+// It was obtained by measuring the radius formed by running the vehicle in the
+//   simulator around in a circle with a constant steering angle and velocity on
+//   a flat terrain.
+//
+// Lf was tuned until the the radius formed by the simulating the model
+//   presented in the classroom matched the previous radius.
+//
+// This is the length from front to CoG that has a similar radius.
+const double Lf = 2.67;
+
+const double ref_cte  = 0.0;
+const double ref_epsi = 0.0;
+//const double mph2ms = 0.44704;
+//const double ref_v    = 40.0 * mph2ms; // in mph, convert to m/s
+const double ref_v    = 50.0;
+
+// Cost weights (video walkthrough weighting).
+const double w_cte    = 2000.0; // Cross Track Error
+const double w_epsi   = 2000.0; // orientation error
+const double w_v      = 0.5;    // deviation to reference speed
+const double w_delta  = 50.0;   // use of steering
+const double w_a      = 5.0;    // use of acceleration
+const double w_ddelta = 6000.0; // sequential steering gaps
+const double w_da     = 10.0;   // sequential acceleration gaps
+
+// Actuator limits: steering of -25 to 25 degrees (scaled by Lf, as in the
+// video walkthrough) and acceleration/decceleration.
+const double max_delta = 0.436332*Lf;
+const double max_a     = 1.0;
+
+typedef Eigen::Matrix<double, 6, 1> Vector6d;
+typedef Eigen::Matrix<double, 6, 6> Matrix6d;
+typedef Eigen::Matrix<double, 6, 2> Matrix62d;
+
+// Model state order: x, y, psi, v, cte, epsi.
+enum { kX = 0, kY, kPsi, kV, kCte, kEpsi };
+
+// One step of the kinematic model, s1 = f(s0, delta0, a0), for any scalar
+// type T with the arithmetic of double and sin, cos and atan found by
+// argument dependent lookup: double and float, CppAD::AD<double> in
+// FG_evalT and Eigen::AutoDiffScalar (see MPCAutoDiff.h). s0 and s1 are
+// states in model order. coeffs are the cubic polynomial coefficients of
+// the reference line, of type T or of one that mixes with it, e.g. double
+// constants.
+template <class T, class C>
+void ModelStepT(const T *s0, const T &delta0, const T &a0, const C *coeffs,
+                double dt, T *s1) {
+  using std::atan;
+  using std::cos;
+  using std::sin;
+  const T &x0 = s0[kX];
+  const T &psi0 = s0[kPsi];
+  const T &v0 = s0[kV];
+  T f0 = coeffs[0] + coeffs[1] * x0 + coeffs[2] * x0 * x0 + coeffs[3] * x0 * x0 * x0;
+  T psides0 = atan(3.0*coeffs[3]*x0*x0+2.0*coeffs[2]*x0+coeffs[1]);
+
+  s1[kX]    = x0 + v0 * cos(psi0) * dt;
+  s1[kY]    = s0[kY] + v0 * sin(psi0) * dt;
+  s1[kPsi]  = psi0 + v0/Lf * delta0 * dt;
+  s1[kV]    = v0 + a0 * dt;
+  s1[kCte]  = f0 - s0[kY] + v0 * sin(s0[kEpsi]) * dt;
+  s1[kEpsi] = psi0 - psides0 + v0/Lf * delta0 * dt;
+}
+
+// ModelStepT() in double.
+inline Vector6d ModelStep(const Vector6d &s0, double delta0, double a0,
+                          const double *coeffs, double dt) {
+  Vector6d s1;
+  ModelStepT(s0.data(), delta0, a0, coeffs, dt, s1.data());
+  return s1;
+}
+
+// Terms of the cost of FG_evalT for any scalar type: of the state of a
+// step, of the actuations of a step, and of the change of the actuations
+// from one move to the next.
+template <class T>
+T StateCostT(const T &v, const T &cte, const T &epsi) {
+  return w_cte * cte * cte + w_epsi * epsi * epsi +
+         w_v * (v - ref_v) * (v - ref_v);
+}
+
+template <class T>
+T ActuationCostT(const T &delta, const T &a) {
+  return w_delta * delta * delta + w_a * a * a;
+}
+
+template <class T>
+T RateCostT(const T &ddelta, const T &da) {
+  return w_ddelta * ddelta * ddelta + w_da * da * da;
+}
+
+// Jacobians A = df/ds0 and B = df/d(delta0, a0) of ModelStep.
+inline void ModelJacobian(const Vector6d &s0, double delta0, double a0,
+                          const double *coeffs, double dt, Matrix6d &A,
+                          Matrix62d &B) {
+  double x0 = s0[kX];
+  double psi0 = s0[kPsi];
+  double v0 = s0[kV];
+  double epsi0 = s0[kEpsi];
+  double df0 = coeffs[1] + 2*coeffs[2]*x0 + 3*coeffs[3]*x0*x0;  // f'(x0)
+  double ddf0 = 2*coeffs[2] + 6*coeffs[3]*x0;                    // f''(x0)
+
+  A.setZero();
+  B.setZero();
+  A(kX, kX) = 1.0;
+  A(kX, kPsi) = -v0 * std::sin(psi0) * dt;
+  A(kX, kV) = std::cos(psi0) * dt;
+  A(kY, kY) = 1.0;
+  A(kY, kPsi) = v0 * std::cos(psi0) * dt;
+  A(kY, kV) = std::sin(psi0) * dt;
+  A(kPsi, kPsi) = 1.0;
+  A(kPsi, kV) = delta0 / Lf * dt;
+  B(kPsi, 0) = v0 / Lf * dt;
+  A(kV, kV) = 1.0;
+  B(kV, 1) = dt;
+  A(kCte, kX) = df0;
+  A(kCte, kY) = -1.0;
+  A(kCte, kV) = std::sin(epsi0) * dt;
+  A(kCte, kEpsi) = v0 * std::cos(epsi0) * dt;
+  A(kEpsi, kX) = -ddf0 / (1.0 + df0 * df0);
+  A(kEpsi, kPsi) = 1.0;
+  A(kEpsi, kV) = delta0 / Lf * dt;
+  B(kEpsi, 0) = v0 / Lf * dt;
+}
+
+// Taken from the MPC quiz:
+// The solver takes all the state variables and actuator
+// variables in a singular vector. Thus, we should to establish
+// when one variable starts and another ends to make our lifes easier.
+//
+// With move blocking the actuations are held constant over blocks of steps:
+// `blocks` are the block lengths in steps, e.g. {1, 1, 2, 2, 3}, and each
+// block has one delta and one a variable, a move. The last block is
+// extended or cut to end with step N-2. Without blocks every step has a
+// move of its own.
+//
+// The time grid is uniform with step size dt, or given by the sizes of the
+// N - 1 steps, e.g. short steps first for the near term and long ones
+// later for a longer lookahead with the same number of variables. Step t
+// goes from the state of step t to the one of step t + 1 and takes Dt(t).
+struct MPCLayout {
+  MPCLayout(size_t N, double dt,
+            const std::vector<size_t> &blocks = std::vector<size_t>())
+      : N(N), dt(dt),
+        step_dt(N > 0 ? N - 1 : 0, dt),
+        x_start(0),
+        y_start(x_start + N),
+        psi_start(y_start + N),
+        v_start(psi_start + N),
+        cte_start(v_start + N),
+        epsi_start(cte_start + N),
+        delta_start(epsi_start + N),
+        n_constraints(6 * N) {
+    // `end` is the first step after the current move; the last block never
+    // ends.
+    size_t move = 0;
+    size_t end = blocks.empty() ? 1 : std::max<size_t>(blocks[0], 1);
+    for (size_t t = 0; t + 1 < N; ++t) {
+      if (t == end && (blocks.empty() || move + 1 < blocks.size())) {
+        ++move;
+        end += blocks.empty() ? 1 : std::max<size_t>(blocks[move], 1);
+      }
+      step_move.push_back(move);
+    }
+    n_moves = move + 1;
+    a_start = delta_start + n_moves;
+    n_vars = 6 * N + 2 * n_moves;
+  }
+
+  // Non-uniform grid of the step sizes `dts`, N = dts.size() + 1.
+  MPCLayout(const std::vector<double> &dts,
+            const std::vector<size_t> &blocks = std::vector<size_t>())
+      : MPCLayout(dts.size() + 1, dts.empty() ? 0.0 : dts[0], blocks) {
+    step_dt = dts;
+  }
+
+  // Offset of state k, in the order x, y, psi, v, cte, epsi.
+  size_t StateStart(size_t k) const { return x_start + k * N; }
+  // Move of the actuations of step t.
+  size_t Move(size_t t) const { return step_move[t]; }
+  bool IsBlocked() const { return n_moves + 1 != N; }
+
+  double Dt(size_t t) const { return step_dt[t]; }
+  // Time from the first to the last state.
+  double Duration() const {
+    double duration = 0.0;
+    for (double step : step_dt) {
+      duration += step;
+    }
+    return duration;
+  }
+
+  size_t N;
+  // Step size of a uniform grid, the first step of a non-uniform one.
+  double dt;
+  std::vector<double> step_dt;
+  size_t x_start;
+  size_t y_start;
+  size_t psi_start;
+  size_t v_start;
+  size_t cte_start;
+  size_t epsi_start;
+  size_t delta_start;
+  size_t a_start;
+  size_t n_moves;
+  size_t n_vars;
+  size_t n_constraints;
+  std::vector<size_t> step_move;
+};
+
+// The same layout with the horizon fixed at compile time. All offsets are
+// constant expressions, so loops over the horizon have constant trip counts.
+template <size_t kN>
+struct FixedLayout {
+  explicit FixedLayout(double dt) : dt(dt) {}
+
+  static constexpr size_t N           = kN;
+  static constexpr size_t x_start     = 0;
+  static constexpr size_t y_start     = x_start + N;
+  static constexpr size_t psi_start   = y_start + N;
+  static constexpr size_t v_start     = psi_start + N;
+  static constexpr size_t cte_start   = v_start + N;
+  static constexpr size_t epsi_start  = cte_start + N;
+  static constexpr size_t delta_start = epsi_start + N;
+  static constexpr size_t a_start     = delta_start + N - 1;
+  static constexpr size_t n_moves     = N - 1;
+  static constexpr size_t n_vars      = 6 * N + 2 * (N - 1);
+  static constexpr size_t n_constraints = 6 * N;
+
+  static constexpr size_t StateStart(size_t k) { return x_start + k * N; }
+
+  // No move blocking and a uniform grid.
+  static constexpr size_t Move(size_t t) { return t; }
+  static constexpr bool IsBlocked() { return false; }
+  double Dt(size_t) const { return dt; }
+
+  double dt;
+};
+
+template <size_t kN> constexpr size_t FixedLayout<kN>::N;
+template <size_t kN> constexpr size_t FixedLayout<kN>::x_start;
+template <size_t kN> constexpr size_t FixedLayout<kN>::y_start;
+template <size_t kN> constexpr size_t FixedLayout<kN>::psi_start;
+template <size_t kN> constexpr size_t FixedLayout<kN>::v_start;
+template <size_t kN> constexpr size_t FixedLayout<kN>::cte_start;
+template <size_t kN> constexpr size_t FixedLayout<kN>::epsi_start;
+template <size_t kN> constexpr size_t FixedLayout<kN>::delta_start;
+template <size_t kN> constexpr size_t FixedLayout<kN>::a_start;
+template <size_t kN> constexpr size_t FixedLayout<kN>::n_moves;
+template <size_t kN> constexpr size_t FixedLayout<kN>::n_vars;
+template <size_t kN> constexpr size_t FixedLayout<kN>::n_constraints;
+
+// Structural nonzeros of a sparse matrix as (row, column) pairs.
+typedef std::vector<std::pair<size_t, size_t> > SparsityPattern;
+
+// Sparsity of the NLP of FG_evalT, read off the block banded layout instead
+// of the tape. The columns are the variables followed by the 4 polynomial
+// coefficients, as in the independent vector of MPCTape. `jac` is the
+// pattern of the Jacobian of [cost, constraints] (row 0 the cost), `hes`
+// the lower triangle of the Hessian of any weighted sum of them. Entries
+// may repeat.
+template <class Layout>
+void MPCSparsityT(const Layout &layout, SparsityPattern &jac,
+                  SparsityPattern &hes) {
+  const size_t N = layout.N;
+  const size_t c0 = layout.n_vars;
+  const size_t c1 = c0 + 1, c2 = c0 + 2, c3 = c0 + 3;
+  jac.clear();
+  hes.clear();
+
+  // Cost: squares of the states and actuations and of the actuation rates.
+  for (size_t t = 0; t < N; ++t) {
+    const size_t vars[] = {layout.v_start + t, layout.cte_start + t,
+                           layout.epsi_start + t};
+    for (size_t i : vars) {
+      jac.push_back(std::make_pair(size_t(0), i));
+      hes.push_back(std::make_pair(i, i));
+    }
+  }
+  for (size_t t = 0; t + 1 < N; ++t) {
+    const size_t m0 = layout.Move(t);
+    const size_t m1 = t + 2 < N ? layout.Move(t + 1) : m0;
+    const size_t vars[] = {layout.delta_start, layout.a_start};
+    for (size_t start : vars) {
+      jac.push_back(std::make_pair(size_t(0), start + m0));
+      hes.push_back(std::make_pair(start + m0, start + m0));
+      if (m1 != m0) {
+        hes.push_back(std::make_pair(start + m1, start + m0));
+      }
+    }
+  }
+
+  // Initial state constraints.
+  for (size_t k = 0; k < 6; ++k) {
+    jac.push_back(
+        std::make_pair(1 + layout.StateStart(k), layout.StateStart(k)));
+  }
+
+  // Model constraints of step t, linking the state of step t to state and
+  // actuations of step t - 1.
+  for (size_t t = 1; t < N; ++t) {
+    const size_t x0 = layout.x_start + t - 1;
+    const size_t y0 = layout.y_start + t - 1;
+    const size_t psi0 = layout.psi_start + t - 1;
+    const size_t v0 = layout.v_start + t - 1;
+    const size_t epsi0 = layout.epsi_start + t - 1;
+    const size_t delta0 = layout.delta_start + layout.Move(t - 1);
+    const size_t a0 = layout.a_start + layout.Move(t - 1);
+
+    const size_t rows[6][8] = {
+        {x0, psi0, v0},                          // x
+        {y0, psi0, v0},                          // y
+        {psi0, v0, delta0},                      // psi
+        {v0, a0},                                // v
+        {x0, y0, v0, epsi0, c0, c1, c2, c3},     // cte
+        {x0, psi0, v0, delta0, c1, c2, c3},      // epsi
+    };
+    const size_t lengths[6] = {3, 3, 3, 2, 8, 7};
+    for (size_t k = 0; k < 6; ++k) {
+      const size_t row = 1 + layout.StateStart(k) + t;
+      jac.push_back(std::make_pair(row, layout.StateStart(k) + t));
+      for (size_t j = 0; j < lengths[k]; ++j) {
+        jac.push_back(std::make_pair(row, rows[k][j]));
+      }
+    }
+
+    // v0 * cos(psi0), v0 * sin(psi0), v0 * delta0 and v0 * sin(epsi0).
+    hes.push_back(std::make_pair(psi0, psi0));
+    hes.push_back(std::make_pair(v0, psi0));
+    hes.push_back(std::make_pair(delta0, v0));
+    hes.push_back(std::make_pair(epsi0, epsi0));
+    hes.push_back(std::make_pair(epsi0, v0));
+    // f(x0) and atan(f'(x0)) couple x0 and c1..c3 with each other.
+    const size_t poly[] = {x0, c1, c2, c3};
+    for (size_t i = 0; i < 4; ++i) {
+      for (size_t j = 0; j <= i; ++j) {
+        hes.push_back(std::make_pair(poly[i], poly[j]));
+      }
+    }
+  }
+}
+
+// State of step t in the variable vector `vars`.
+template <class Layout>
+Vector6d StateAt(const Layout &layout, const double *vars, size_t t) {
+  Vector6d s;
+  s << vars[layout.x_start + t], vars[layout.y_start + t],
+       vars[layout.psi_start + t], vars[layout.v_start + t],
+       vars[layout.cte_start + t], vars[layout.epsi_start + t];
+  return s;
+}
+
+template <class Layout>
+void SetStateAt(const Layout &layout, const Vector6d &s, size_t t,
+                double *vars) {
+  vars[layout.x_start + t]    = s[kX];
+  vars[layout.y_start + t]    = s[kY];
+  vars[layout.psi_start + t]  = s[kPsi];
+  vars[layout.v_start + t]    = s[kV];
+  vars[layout.cte_start + t]  = s[kCte];
+  vars[layout.epsi_start + t] = s[kEpsi];
+}
+
+// Overwrite the states of steps 1..N-1 in `vars` by rolling the model
+// forward from the state of step 0 with the actuations in `vars`.
+template <class Layout>
+void RolloutT(const Layout &layout, const double *coeffs, double *vars) {
+  for (size_t t = 1; t < layout.N; ++t) {
+    Vector6d s1 = ModelStep(StateAt(layout, vars, t - 1),
+                            vars[layout.delta_start + layout.Move(t - 1)],
+                            vars[layout.a_start + layout.Move(t - 1)], coeffs,
+                            layout.Dt(t - 1));
+    SetStateAt(layout, s1, t, vars);
+  }
+}
+
+// Fill the constraint bounds: the model equations hold exactly and the
+// initial state equals `state`.
+template <class Layout>
+void SetConstraintBoundsT(const Layout &layout, const double *state,
+                          double *constraints_lowerbound,
+                          double *constraints_upperbound) {
+  // Lower and upper limits for the constraints
+  // Should be 0 besides initial state.
+  for (size_t i = 0; i < layout.n_constraints; ++i) {
+    constraints_lowerbound[i] = 0;
+    constraints_upperbound[i] = 0;
+  }
+  for (size_t k = 0; k < 6; ++k) {
+    constraints_lowerbound[layout.StateStart(k)] = state[k];
+    constraints_upperbound[layout.StateStart(k)] = state[k];
+  }
+}
+
+// Fill the variable and constraint bounds for the initial `state`.
+// The constraint bounds are skipped if their pointers are NULL.
+template <class Layout>
+void SetBoundsT(const Layout &layout, const double *state,
+                double *vars_lowerbound, double *vars_upperbound,
+                double *constraints_lowerbound,
+                double *constraints_upperbound) {
+  /**
+   * DONE: Set lower and upper limits for variables.
+   */
+  // Set all non-actuators upper and lowerlimits
+  // to the max negative and positive values.
+  for (size_t i = 0; i < layout.delta_start; ++i) {
+    vars_lowerbound[i] = -1.0e19;
+    vars_upperbound[i] =  1.0e19;
+  }
+
+  // The upper and lower limits of delta are set to -25 and 25
+  // degrees (values in radians).
+  // NOTE: Feel free to change this to something else.
+  for (size_t i = layout.delta_start; i < layout.a_start; ++i) {
+#ifdef USE_MPC_QUIZ_INSTEAD_OF_VIDEO_WALKTHROUGH
+    vars_lowerbound[i] = -0.436332;
+    vars_upperbound[i] =  0.436332;
+#else
+    vars_lowerbound[i] = -max_delta;
+    vars_upperbound[i] =  max_delta;
+#endif
+  }
+
+  // Acceleration/decceleration upper and lower limits.
+  // NOTE: Feel free to change this to something else.
+  for (size_t i = layout.a_start; i < layout.n_vars; ++i) {
+    vars_lowerbound[i] = -max_a;
+    vars_upperbound[i] =  max_a;
+  }
+
+  if (constraints_lowerbound != NULL && constraints_upperbound != NULL) {
+    SetConstraintBoundsT(layout, state, constraints_lowerbound,
+                         constraints_upperbound);
+  }
+}
+
+// Shift the block of `len` entries starting at `start` one step forward,
+// repeating the last entry.
+inline void ShiftBlock(double *v, size_t start, size_t len) {
+  for (size_t t = 0; t + 1 < len; ++t) {
+    v[start + t] = v[start + t + 1];
+  }
+}
+
+// Shift the moves starting at `moves` one step forward: each move takes the
+// value of the move of the step after its first step, the last move is
+// repeated. Without move blocking this is ShiftBlock() over N-1 entries.
+template <class Layout, class T>
+void ShiftMovesT(const Layout &layout, T *moves) {
+  size_t first = 0;
+  for (size_t m = 0; m < layout.n_moves; ++m) {
+    while (layout.Move(first) < m) {
+      ++first;
+    }
+    moves[m] = moves[layout.Move(std::min(first + 1, layout.N - 2))];
+  }
+}
+
+// Shift a previous solution and its multipliers (bounds, constraints) one
+// step forward in time, so it can be used as the starting point of the
+// next solve.
+template <class Layout>
+void ShiftWarmStartT(const Layout &layout, const double *state,
+                     const double *coeffs, double *x, double *zl, double *zu,
+                     double *lambda) {
+  const size_t N = layout.N;
+  for (size_t k = 0; k < 6; ++k) {
+    ShiftBlock(x, layout.StateStart(k), N);
+    ShiftBlock(zl, layout.StateStart(k), N);
+    ShiftBlock(zu, layout.StateStart(k), N);
+    ShiftBlock(lambda, layout.StateStart(k), N);
+  }
+  double *vectors[] = {x, zl, zu};
+  for (double *v : vectors) {
+    ShiftMovesT(layout, v + layout.delta_start);
+    ShiftMovesT(layout, v + layout.a_start);
+  }
+
+  // The old trajectory lives in the previous vehicle frame. Roll the model
+  // forward from the new state with the shifted actuations instead.
+  for (size_t k = 0; k < 6; ++k) {
+    x[layout.StateStart(k)] = state[k];
+  }
+  RolloutT(layout, coeffs, x);
+}
+
+// Value of the cost of FG_evalT for the variables `vars`.
+template <class Layout>
+double MPCCost(const Layout &layout, const double *vars) {
+  double cost = 0.0;
+  for (size_t t = 0; t < layout.N; ++t) {
+    cost += StateCostT(vars[layout.v_start + t], vars[layout.cte_start + t],
+                       vars[layout.epsi_start + t]);
+  }
+  for (size_t t = 0; t + 1 < layout.N; ++t) {
+    cost += ActuationCostT(vars[layout.delta_start + layout.Move(t)],
+                           vars[layout.a_start + layout.Move(t)]);
+  }
+  for (size_t t = 0; t + 2 < layout.N; ++t) {
+    size_t m0 = layout.Move(t);
+    size_t m1 = layout.Move(t + 1);
+    cost += RateCostT(vars[layout.delta_start + m1] - vars[layout.delta_start + m0],
+                      vars[layout.a_start + m1] - vars[layout.a_start + m0]);
+  }
+  return cost;
+}
+
+#endif  // MPC_PROBLEM_H
@@ -0,0 +1,248 @@
+#include "MPCQP.h"
+#include <cmath>
+#include "MPCAutoDiff.h"
+
+using Eigen::MatrixXd;
+using Eigen::VectorXd;
+
+MPCQP::MPCQP(const MPCLayout &layout)
+    : layout(layout),
+      H(MatrixXd::Zero(layout.n_vars, layout.n_vars)),
+      q(VectorXd::Zero(layout.n_vars)),
+      A(layout.N - 1, Matrix6d::Identity()),
+      B(layout.N - 1, Matrix62d::Zero()),
+      c(layout.N - 1, Vector6d::Zero()),
+      x0(Vector6d::Zero()),
+      lb(VectorXd::Constant(layout.n_vars, -1.0e19)),
+      ub(VectorXd::Constant(layout.n_vars, 1.0e19)) {
+  // Cost of FG_evalT (video walkthrough weighting), without its constant
+  // term.
+  const size_t N = layout.N;
+  for (size_t t = 0; t < N; ++t) {
+    H(layout.cte_start + t, layout.cte_start + t) += 2.0 * w_cte;
+    H(layout.epsi_start + t, layout.epsi_start + t) += 2.0 * w_epsi;
+    H(layout.v_start + t, layout.v_start + t) += 2.0 * w_v;
+    q[layout.v_start + t] -= 2.0 * w_v * ref_v;
+  }
+  for (size_t t = 0; t + 1 < N; ++t) {
+    size_t m = layout.Move(t);
+    H(layout.delta_start + m, layout.delta_start + m) += 2.0 * w_delta;
+    H(layout.a_start + m, layout.a_start + m) += 2.0 * w_a;
+  }
+  const size_t rate_starts[] = {layout.delta_start, layout.a_start};
+  const double rate_weights[] = {w_ddelta, w_da};
+  for (size_t k = 0; k < 2; ++k) {
+    for (size_t t = 0; t + 2 < N; ++t) {
+      size_t i = rate_starts[k] + layout.Move(t);
+      size_t j = rate_starts[k] + layout.Move(t + 1);
+      if (i == j) {
+        continue;
+      }
+      double w = 2.0 * rate_weights[k];
+      H(i, i) += w;
+      H(j, j) += w;
+      H(i, j) -= w;
+      H(j, i) -= w;
+    }
+  }
+}
+
+void MPCQP::Linearize(const double *z, const double *coeffs) {
+  for (size_t t = 0; t + 1 < layout.N; ++t) {
+    Vector6d s = StateAt(layout, z, t);
+    Eigen::Vector2d u = ActuationAt(z, t);
+    Vector6d s1;
+    ModelJacobianDual(s, u[0], u[1], coeffs, layout.Dt(t), A[t], B[t], &s1);
+    c[t] = s1 - A[t] * s - B[t] * u;
+  }
+}
+
+void MPCQP::UpdateOffsets(const double *z, const double *coeffs) {
+  for (size_t t = 0; t + 1 < layout.N; ++t) {
+    Vector6d s = StateAt(layout, z, t);
+    Eigen::Vector2d u = ActuationAt(z, t);
+    c[t] = ModelStep(s, u[0], u[1], coeffs, layout.Dt(t)) - A[t] * s -
+           B[t] * u;
+  }
+}
+
+void MPCQP::Rollout(double *z) const {
+  Vector6d s = x0;
+  SetStateAt(layout, s, 0, z);
+  for (size_t t = 0; t + 1 < layout.N; ++t) {
+    s = A[t] * s + B[t] * ActuationAt(z, t) + c[t];
+    SetStateAt(layout, s, t + 1, z);
+  }
+}
+
+void DenseKKTSolver::Prepare(const MPCQP &qp) {
+  const MPCLayout &layout = qp.layout;
+  E_.setZero(layout.n_constraints, layout.n_vars);
+  e_.setZero(layout.n_constraints);
+  for (size_t k = 0; k < 6; ++k) {
+    E_(layout.StateStart(k), layout.StateStart(k)) = 1.0;
+  }
+  for (size_t t = 1; t < layout.N; ++t) {
+    for (size_t k = 0; k < 6; ++k) {
+      size_t row = layout.StateStart(k) + t;
+      E_(row, layout.StateStart(k) + t) = 1.0;
+      for (size_t j = 0; j < 6; ++j) {
+        E_(row, layout.StateStart(j) + t - 1) -= qp.A[t - 1](k, j);
+      }
+      E_(row, layout.delta_start + layout.Move(t - 1)) -= qp.B[t - 1](k, 0);
+      E_(row, layout.a_start + layout.Move(t - 1)) -= qp.B[t - 1](k, 1);
+    }
+  }
+}
+
+bool DenseKKTSolver::Solve(const MPCQP &qp, VectorXd &z) {
+  const MPCLayout &layout = qp.layout;
+  const size_t n = layout.n_vars;
+  for (size_t k = 0; k < 6; ++k) {
+    e_[layout.StateStart(k)] = qp.x0[k];
+  }
+  for (size_t t = 1; t < layout.N; ++t) {
+    for (size_t k = 0; k < 6; ++k) {
+      e_[layout.StateStart(k) + t] = qp.c[t - 1][k];
+    }
+  }
+
+  // Feasible starting point: actuations clipped to their bounds, states
+  // from the linear dynamics. Bounds hit by the clipping form the initial
+  // working set.
+  z = z.cwiseMax(qp.lb).cwiseMin(qp.ub);
+  qp.Rollout(z.data());
+  fixed_.assign(n, 0);
+  for (size_t i = 0; i < n; ++i) {
+    if (HasBound(qp.lb[i]) && z[i] <= qp.lb[i]) {
+      fixed_[i] = -1;
+    } else if (HasBound(qp.ub[i]) && z[i] >= qp.ub[i]) {
+      fixed_[i] = 1;
+    }
+  }
+
+  return Iterate(qp, qp.lb, qp.ub, z);
+}
+
+void DenseKKTSolver::MinimizeFree(const MPCQP &qp, const VectorXd &z,
+                                  VectorXd &candidate) {
+  const size_t n = qp.layout.n_vars;
+  const size_t m = qp.layout.n_constraints;
+  const size_t nf = free_.size();
+  z_fixed_.setZero(n);
+  for (size_t i = 0; i < n; ++i) {
+    if (fixed_[i] != 0) {
+      z_fixed_[i] = z[i];
+    }
+  }
+
+  // KKT system of the equality constrained QP over the free variables,
+  //   [H_FF E_F'] [z_F   ]   [-q_F - H_FW z_W]
+  //   [E_F  0   ] [lambda] = [ e   - E_W  z_W].
+  K_.setZero(nf + m, nf + m);
+  rhs_.resize(nf + m);
+  VectorXd h_fixed = qp.H * z_fixed_;
+  VectorXd e_fixed = E_ * z_fixed_;
+  for (size_t a = 0; a < nf; ++a) {
+    for (size_t b = 0; b < nf; ++b) {
+      K_(a, b) = qp.H(free_[a], free_[b]);
+    }
+    for (size_t r = 0; r < m; ++r) {
+      K_(nf + r, a) = K_(a, nf + r) = E_(r, free_[a]);
+    }
+    rhs_[a] = -qp.q[free_[a]] - h_fixed[free_[a]];
+  }
+  rhs_.tail(m) = e_ - e_fixed;
+  lu_.compute(K_);
+  sol_ = lu_.solve(rhs_);
+
+  for (size_t a = 0; a < nf; ++a) {
+    candidate[free_[a]] = sol_[a];
+  }
+}
+
+void DenseKKTSolver::Gradient(const MPCQP &qp, const VectorXd &z,
+                              VectorXd &r) {
+  r = qp.H * z + qp.q +
+      E_.transpose() * sol_.tail(qp.layout.n_constraints);
+}
+
+bool BoxActiveSetSolver::Iterate(const MPCQP &qp, const VectorXd &lb,
+                                 const VectorXd &ub, VectorXd &x) {
+  const size_t n = x.size();
+  const double step_tol = 1.0e-10;
+  const double mult_tol = 1.0e-8;
+  deadline_hit_ = false;
+  for (last_iterations_ = 0; last_iterations_ < max_iterations;
+       ++last_iterations_) {
+    // Every iterate is feasible, so stopping early still gives a plan.
+    if (deadline.Near(deadline_reserve_ms)) {
+      deadline_hit_ = true;
+      break;
+    }
+    free_.clear();
+    for (size_t i = 0; i < n; ++i) {
+      if (fixed_[i] == 0) {
+        free_.push_back(i);
+      }
+    }
+    candidate_ = x;
+    MinimizeFree(qp, x, candidate_);
+    VectorXd p = candidate_ - x;
+
+    if (p.lpNorm<Eigen::Infinity>() < step_tol) {
+      // Stationary on the working set. Release the bound with the most
+      // wrong-signed multiplier, or stop if there is none.
+      x = candidate_;
+      VectorXd r;
+      Gradient(qp, x, r);
+      size_t release = n;
+      double worst = mult_tol;
+      for (size_t i = 0; i < n; ++i) {
+        if (fixed_[i] == 0 || lb[i] == ub[i]) {
+          continue;
+        }
+        double violation = fixed_[i] < 0 ? -r[i] : r[i];
+        if (violation > worst) {
+          worst = violation;
+          release = i;
+        }
+      }
+      if (release == n) {
+        ++last_iterations_;
+        return true;
+      }
+      fixed_[release] = 0;
+      continue;
+    }
+
+    // Step towards the candidate until the first bound blocks.
+    double alpha = 1.0;
+    size_t blocking = n;
+    int side = 0;
+    for (size_t a = 0; a < free_.size(); ++a) {
+      size_t i = free_[a];
+      if (p[i] < 0.0 && HasBound(lb[i]) && candidate_[i] < lb[i]) {
+        double alpha_i = (lb[i] - x[i]) / p[i];
+        if (alpha_i < alpha) {
+          alpha = alpha_i;
+          blocking = i;
+          side = -1;
+        }
+      } else if (p[i] > 0.0 && HasBound(ub[i]) && candidate_[i] > ub[i]) {
+        double alpha_i = (ub[i] - x[i]) / p[i];
+        if (alpha_i < alpha) {
+          alpha = alpha_i;
+          blocking = i;
+          side = 1;
+        }
+      }
+    }
+    x += alpha * p;
+    if (blocking < n) {
+      fixed_[blocking] = side;
+      x[blocking] = side < 0 ? lb[blocking] : ub[blocking];
+    }
+  }
+  return false;
+}
@@ -0,0 +1,155 @@
+#ifndef MPC_QP_H
+#define MPC_QP_H
+
+#include <vector>
+#include "Eigen-3.3/Eigen/Core"
+#include "Eigen-3.3/Eigen/LU"
+#include "Deadline.h"
+#include "MPCProblem.h"
+
+//
+// Quadratic program of one SQP step of the MPC problem:
+//
+//   min  0.5 z'Hz + q'z
+//   s.t. s_0     = x0
+//        s_{t+1} = A_t s_t + B_t u_t + c_t,   t = 0..N-2
+//        lb <= z <= ub
+//
+// over the variables z in the order of MPCLayout (states, then delta and a),
+// with s_t the state and u_t = (delta_t, a_t) the actuation of step t.
+// H and q are the cost of FG_evalT, which is quadratic already; the dynamics
+// are the model linearized around a trajectory. Bounds of magnitude 1e19
+// and above are treated as absent.
+//
+struct MPCQP {
+  typedef std::vector<Matrix6d, Eigen::aligned_allocator<Matrix6d> >
+      Matrix6dVector;
+  typedef std::vector<Matrix62d, Eigen::aligned_allocator<Matrix62d> >
+      Matrix62dVector;
+  typedef std::vector<Vector6d, Eigen::aligned_allocator<Vector6d> >
+      Vector6dVector;
+
+  explicit MPCQP(const MPCLayout &layout);
+
+  MPCLayout layout;
+  Eigen::MatrixXd H;
+  Eigen::VectorXd q;
+  Matrix6dVector A;
+  Matrix62dVector B;
+  Vector6dVector c;
+  Vector6d x0;
+  Eigen::VectorXd lb, ub;
+
+  // Linearize the model around the states and actuations in `z`: sets A, B
+  // and c.
+  void Linearize(const double *z, const double *coeffs);
+
+  // Recompute c for new polynomial coefficients around the same `z`,
+  // keeping A and B.
+  void UpdateOffsets(const double *z, const double *coeffs);
+
+  // Overwrite the states in `z` by the trajectory of the linear dynamics
+  // from x0 with the actuations in `z`.
+  void Rollout(double *z) const;
+
+  // Actuation of step t in `z`, that of its move with move blocking.
+  Eigen::Vector2d ActuationAt(const double *z, size_t t) const {
+    size_t m = layout.Move(t);
+    return Eigen::Vector2d(z[layout.delta_start + m], z[layout.a_start + m]);
+  }
+};
+
+inline bool HasBound(double bound) { return bound > -1.0e19 && bound < 1.0e19; }
+
+//
+// Solver of MPCQP.
+//
+// Prepare() is called whenever H, A or B change and may factorize or
+// condense; Solve() is then called for new c, x0 and bounds only.
+//
+class MPCQPSolver {
+ public:
+  virtual ~MPCQPSolver() {}
+
+  virtual void Prepare(const MPCQP &qp) = 0;
+
+  // Solve the QP. On entry `z` is the starting point (its actuations at
+  // least), on exit the solution. Returns false if the solver stopped
+  // early; `z` still satisfies dynamics and bounds then.
+  virtual bool Solve(const MPCQP &qp, Eigen::VectorXd &z) = 0;
+
+  // Stop iterating once the deadline is near.
+  Deadline deadline;
+  double deadline_reserve_ms = 0.2;
+
+  int LastIterations() const { return last_iterations_; }
+  bool DeadlineHit() const { return deadline_hit_; }
+
+ protected:
+  int last_iterations_ = -1;
+  bool deadline_hit_ = false;
+};
+
+//
+// Primal active-set method over box constraints lb <= x <= ub, shared by
+// the solvers below. Variables in the working set are fixed at their
+// bound; each iteration minimizes over the others with MinimizeFree() and
+// steps towards that minimizer until the first bound blocks, adding it to
+// the working set. At the minimizer the bound with the most wrong-signed
+// multiplier is released, and the method stops once there is none.
+//
+class BoxActiveSetSolver : public MPCQPSolver {
+ public:
+  int max_iterations = 50;
+
+ protected:
+  // Iterate from `x`, feasible, with the working set in fixed_. Returns
+  // false if stopped early; `x` is feasible then too.
+  bool Iterate(const MPCQP &qp, const Eigen::VectorXd &lb,
+               const Eigen::VectorXd &ub, Eigen::VectorXd &x);
+
+  // Set the variables in free_ of `candidate`, which is `x` on entry, to
+  // the minimizer over them with the others at their value in `x`.
+  virtual void MinimizeFree(const MPCQP &qp, const Eigen::VectorXd &x,
+                            Eigen::VectorXd &candidate) = 0;
+  // Gradient at the last minimizer `x`, with the multipliers of the
+  // equality constraints if any: that of the bounds in the working set.
+  virtual void Gradient(const MPCQP &qp, const Eigen::VectorXd &x,
+                        Eigen::VectorXd &r) = 0;
+
+  // Working set: 0 free, -1 at the lower, +1 at the upper bound.
+  std::vector<int> fixed_;
+  std::vector<size_t> free_;
+  Eigen::VectorXd candidate_;
+};
+
+//
+// Primal active-set method on the full (sparse in structure, stored dense)
+// KKT system. Variables in the working set are fixed at their bound, the
+// remaining equality constrained QP is solved with a partial pivoting LU.
+// The working set starts from the bounds that are active in the starting
+// point, so a shifted previous solution warm starts it.
+//
+class DenseKKTSolver : public BoxActiveSetSolver {
+ public:
+  void Prepare(const MPCQP &qp) override;
+  bool Solve(const MPCQP &qp, Eigen::VectorXd &z) override;
+
+ private:
+  void MinimizeFree(const MPCQP &qp, const Eigen::VectorXd &z,
+                    Eigen::VectorXd &candidate) override;
+  void Gradient(const MPCQP &qp, const Eigen::VectorXd &z,
+                Eigen::VectorXd &r) override;
+
+  // Equality constraints E z = e in the order of the FG_evalT constraints.
+  Eigen::MatrixXd E_;
+  Eigen::VectorXd e_;
+
+  Eigen::MatrixXd K_;
+  Eigen::VectorXd rhs_;
+  Eigen::VectorXd sol_;
+  Eigen::VectorXd z_fixed_;
+  Eigen::PartialPivLU<Eigen::MatrixXd> lu_;
+};
+
+#endif  // MPC_QP_H
@@ -0,0 +1,171 @@
+#include "MPCTable.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "MPCProblem.h"
+
+namespace {
+
+const char kMagic[8] = {'M', 'P', 'C', 'T', 'A', 'B', 'L', 'E'};
+const uint32_t kVersion = 1;
+const uint32_t kNumOutputs = 2;
+
+// Largest deviation of x, y, psi from zero and of c0, c1 from cte, epsi
+// that is still on the grid.
+const double kFrameTolerance = 1.0e-6;
+
+}  // namespace
+
+size_t MPCTableHeader::NumPoints() const {
+  size_t n = 1;
+  for (size_t k = 0; k < kTableAxes; ++k) {
+    n *= axes[k].count;
+  }
+  return n;
+}
+
+MPCTableHeader MakeMPCTableHeader(const MPCTableAxis *axes, size_t N,
+                                  double dt) {
+  MPCTableHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, kMagic, sizeof(kMagic));
+  header.version = kVersion;
+  header.num_axes = kTableAxes;
+  header.num_outputs = kNumOutputs;
+  header.N = N;
+  header.dt = dt;
+  for (size_t k = 0; k < kTableAxes; ++k) {
+    header.axes[k] = axes[k];
+  }
+  return header;
+}
+
+void MPCTableProblem(const double *q, Eigen::VectorXd &state,
+                     Eigen::VectorXd &coeffs) {
+  state.resize(6);
+  state << 0.0, 0.0, 0.0, q[kTableV], q[kTableCte], q[kTableEpsi];
+  coeffs.resize(4);
+  coeffs << q[kTableCte], -std::tan(q[kTableEpsi]), q[kTableC2], q[kTableC3];
+}
+
+MPCTable::~MPCTable() {
+  if (map_) {
+    munmap(map_, map_size_);
+  }
+}
+
+bool MPCTable::Load(const std::string &path, std::string *error) {
+  int fd = open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    *error = "cannot open " + path;
+    return false;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0 ||
+      static_cast<size_t>(st.st_size) < sizeof(MPCTableHeader)) {
+    close(fd);
+    *error = path + " is too short";
+    return false;
+  }
+  void *map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    *error = "cannot map " + path;
+    return false;
+  }
+
+  const MPCTableHeader *header = static_cast<const MPCTableHeader *>(map);
+  bool valid = std::memcmp(header->magic, kMagic, sizeof(kMagic)) == 0 &&
+               header->version == kVersion &&
+               header->num_axes == kTableAxes &&
+               header->num_outputs == kNumOutputs;
+  for (size_t k = 0; valid && k < kTableAxes; ++k) {
+    valid = header->axes[k].count >= 2 &&
+            header->axes[k].max > header->axes[k].min;
+  }
+  if (!valid || static_cast<size_t>(st.st_size) !=
+                    sizeof(MPCTableHeader) +
+                        header->NumPoints() * kNumOutputs * sizeof(float)) {
+    munmap(map, st.st_size);
+    *error = path + " is no MPC table of this version";
+    return false;
+  }
+
+  if (map_) {
+    munmap(map_, map_size_);
+  }
+  map_ = map;
+  map_size_ = st.st_size;
+  header_ = header;
+  data_ = reinterpret_cast<const float *>(header + 1);
+  size_t stride = kNumOutputs;
+  for (size_t k = kTableAxes; k-- > 0;) {
+    strides_[k] = stride;
+    stride *= header->axes[k].count;
+  }
+  return true;
+}
+
+bool MPCTable::Matches(const MPCLayout &layout) const {
+  if (!header_ || layout.N != header_->N || layout.IsBlocked()) {
+    return false;
+  }
+  for (size_t t = 0; t + 1 < layout.N; ++t) {
+    if (std::fabs(layout.Dt(t) - header_->dt) > 1.0e-9) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool MPCTable::Lookup(const Eigen::VectorXd &state,
+                      const Eigen::VectorXd &coeffs, double *delta,
+                      double *a) const {
+  if (!data_ || std::fabs(state[kX]) > kFrameTolerance ||
+      std::fabs(state[kY]) > kFrameTolerance ||
+      std::fabs(state[kPsi]) > kFrameTolerance ||
+      std::fabs(coeffs[0] - state[kCte]) > kFrameTolerance ||
+      std::fabs(std::atan(-coeffs[1]) - state[kEpsi]) > kFrameTolerance) {
+    return false;
+  }
+  const double q[kTableAxes] = {state[kV], state[kCte], state[kEpsi],
+                                coeffs[2], coeffs[3]};
+
+  // Cell and position within it along every axis.
+  size_t base = 0;
+  double frac[kTableAxes];
+  for (size_t k = 0; k < kTableAxes; ++k) {
+    const MPCTableAxis &axis = header_->axes[k];
+    double u = (q[k] - axis.min) / (axis.max - axis.min) * (axis.count - 1);
+    if (!(u >= 0.0 && u <= axis.count - 1)) {
+      return false;
+    }
+    size_t i = std::min<size_t>(static_cast<size_t>(u), axis.count - 2);
+    base += i * strides_[k];
+    frac[k] = u - i;
+  }
+
+  // Weighted sum over the 2^kTableAxes corners of the cell.
+  double out[kNumOutputs] = {0.0, 0.0};
+  for (unsigned corner = 0; corner < (1u << kTableAxes); ++corner) {
+    size_t index = base;
+    double weight = 1.0;
+    for (size_t k = 0; k < kTableAxes; ++k) {
+      if (corner & (1u << k)) {
+        index += strides_[k];
+        weight *= frac[k];
+      } else {
+        weight *= 1.0 - frac[k];
+      }
+    }
+    out[0] += weight * data_[index];
+    out[1] += weight * data_[index + 1];
+  }
+  *delta = out[0];
+  *a = out[1];
+  return true;
+}
@@ -0,0 +1,88 @@
+#ifndef MPC_TABLE_H
+#define MPC_TABLE_H
+
+#include <stdint.h>
+#include <cstddef>
+#include <string>
+#include "Eigen-3.3/Eigen/Core"
+#include "MPCProblem.h"
+
+//
+// Explicit MPC: the first actuations of MPC::Solve() precomputed on a grid
+// (by mpc_table_gen) and interpolated multilinearly at runtime.
+//
+// The grid axes are speed, cross track error, orientation error and the
+// curvature terms c2, c3 of the reference polynomial. The rest of the
+// problem follows from these in the vehicle frame of main: x = y = psi = 0,
+// c0 = cte and c1 = -tan(epsi). Any other state, or one outside the grid,
+// is off the grid and has to be solved online. In particular a state
+// predicted after a latency (LATENCY_HANDLING) has x, y and psi moved off
+// 0, so main refuses a table when it predicts over a latency_dt above 0.
+//
+// The file is a MPCTableHeader followed by the (delta, a) pairs as float,
+// the last axis varying fastest.
+//
+enum { kTableV = 0, kTableCte, kTableEpsi, kTableC2, kTableC3, kTableAxes };
+
+struct MPCTableAxis {
+  double min;
+  double max;
+  uint32_t count;  // at least 2
+  uint32_t padding;
+
+  double Value(size_t i) const { return min + (max - min) * i / (count - 1); }
+};
+
+struct MPCTableHeader {
+  char magic[8];  // "MPCTABLE"
+  uint32_t version;
+  uint32_t num_axes;
+  uint32_t num_outputs;
+  uint32_t N;  // horizon of the solves
+  double dt;
+  MPCTableAxis axes[kTableAxes];
+
+  size_t NumPoints() const;
+};
+
+// Header of a table for `axes`, with the horizon N and dt of the solves.
+MPCTableHeader MakeMPCTableHeader(const MPCTableAxis *axes, size_t N,
+                                  double dt);
+
+// State and polynomial coefficients of the grid point with the axis
+// values `q`, as main would pass them to MPC::Solve().
+void MPCTableProblem(const double *q, Eigen::VectorXd &state,
+                     Eigen::VectorXd &coeffs);
+
+class MPCTable {
+ public:
+  MPCTable() {}
+  ~MPCTable();
+
+  // Memory-map the table in `path`. Returns false, with a message in
+  // `error`, if it cannot be read or is no table.
+  bool Load(const std::string &path, std::string *error);
+  bool IsLoaded() const { return data_ != nullptr; }
+  const MPCTableHeader &Header() const { return *header_; }
+
+  // Whether the table was solved for `layout`: the horizon N and uniform
+  // step dt of the header, without move blocking.
+  bool Matches(const MPCLayout &layout) const;
+
+  // First actuations for `state` and `coeffs`. Returns false if the
+  // problem is off the grid.
+  bool Lookup(const Eigen::VectorXd &state, const Eigen::VectorXd &coeffs,
+              double *delta, double *a) const;
+
+ private:
+  MPCTable(const MPCTable &) = delete;
+  MPCTable &operator=(const MPCTable &) = delete;
+
+  void *map_ = nullptr;
+  size_t map_size_ = 0;
+  const MPCTableHeader *header_ = nullptr;
+  const float *data_ = nullptr;
+  size_t strides_[kTableAxes];
+};
+
+#endif  // MPC_TABLE_H
@@ -0,0 +1,275 @@
+#include "MPCTape.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <mutex>
+
+#define CHECK_SPARSITY
+#undef CHECK_SPARSITY // comment to check given sparsity patterns against the tape
+
+namespace {
+
+std::mutex cppad_threads_mutex;
+// CppAD thread numbers handed out so far, those given back by threads that
+// have exited, and those reserved for the threads of pools.
+std::atomic<size_t> num_cppad_threads(0);
+std::vector<size_t> free_cppad_threads;
+size_t num_reserved_cppad_threads = 0;
+
+// CppAD thread number of a thread, from its first use of CppAD until it
+// exits.
+struct CppADThread {
+  CppADThread() {
+    std::lock_guard<std::mutex> lock(cppad_threads_mutex);
+    if (!free_cppad_threads.empty()) {
+      num = free_cppad_threads.back();
+      free_cppad_threads.pop_back();
+    } else if (num_cppad_threads < CPPAD_MAX_NUM_THREADS) {
+      num = num_cppad_threads++;
+    } else {
+      std::cerr << "More than " << CPPAD_MAX_NUM_THREADS
+                << " threads use CppAD at once" << std::endl;
+      std::abort();
+    }
+  }
+  ~CppADThread() {
+    std::lock_guard<std::mutex> lock(cppad_threads_mutex);
+    free_cppad_threads.push_back(num);
+  }
+
+  size_t num;
+};
+
+size_t CppADThreadNum() {
+  static thread_local CppADThread thread;
+  return thread.num;
+}
+
+// Parallel as soon as a second thread has used CppAD.
+bool CppADInParallel() { return num_cppad_threads > 1; }
+
+}  // namespace
+
+void SetupCppADThreads() {
+  static bool done = false;
+  if (done) {
+    return;
+  }
+  // The calling thread becomes thread 0.
+  CppADThreadNum();
+  CppAD::thread_alloc::parallel_setup(CPPAD_MAX_NUM_THREADS, CppADInParallel,
+                                      CppADThreadNum);
+  CppAD::thread_alloc::hold_memory(true);
+  CppAD::parallel_ad<double>();
+  done = true;
+}
+
+size_t ReserveCppADThreads(size_t n) {
+  std::lock_guard<std::mutex> lock(cppad_threads_mutex);
+  // Number 0 stays with the main thread.
+  n = std::min(n, CPPAD_MAX_NUM_THREADS - 1 - num_reserved_cppad_threads);
+  num_reserved_cppad_threads += n;
+  return n;
+}
+
+void ReleaseCppADThreads(size_t n) {
+  std::lock_guard<std::mutex> lock(cppad_threads_mutex);
+  num_reserved_cppad_threads -= n;
+}
+
+void MPCTape::ComputeSparsity() {
+  size_t n_u = n_vars_ + n_params_;
+  size_t n_fg = 1 + n_constraints_;
+
+  // Jacobian pattern of the whole tape, via an identity seed.
+  CppAD::vectorBool identity(n_u * n_u);
+  for (size_t i = 0; i < n_u; ++i) {
+    for (size_t j = 0; j < n_u; ++j) {
+      identity[i * n_u + j] = (i == j);
+    }
+  }
+  jac_pattern_ = fun_.ForSparseJac(n_u, identity);
+
+  // Hessian pattern of any linear combination of cost and constraints.
+  CppAD::vectorBool select(n_fg);
+  for (size_t i = 0; i < n_fg; ++i) {
+    select[i] = true;
+  }
+  hes_pattern_ = fun_.RevSparseHes(n_u, select);
+}
+
+void MPCTape::SetSparsity(const Pattern &jac, const Pattern &hes) {
+  size_t n_u = n_vars_ + n_params_;
+  size_t n_fg = 1 + n_constraints_;
+
+  jac_pattern_.resize(n_fg * n_u);
+  for (size_t k = 0; k < jac_pattern_.size(); ++k) {
+    jac_pattern_[k] = false;
+  }
+  for (const std::pair<size_t, size_t> &e : jac) {
+    jac_pattern_[e.first * n_u + e.second] = true;
+  }
+  hes_pattern_.resize(n_u * n_u);
+  for (size_t k = 0; k < hes_pattern_.size(); ++k) {
+    hes_pattern_[k] = false;
+  }
+  for (const std::pair<size_t, size_t> &e : hes) {
+    hes_pattern_[e.first * n_u + e.second] = true;
+    hes_pattern_[e.second * n_u + e.first] = true;
+  }
+
+#ifdef CHECK_SPARSITY
+  // A missing nonzero silently corrupts the derivatives.
+  CppAD::vectorBool jac_given = jac_pattern_;
+  CppAD::vectorBool hes_given = hes_pattern_;
+  ComputeSparsity();
+  for (size_t k = 0; k < jac_given.size(); ++k) {
+    assert(jac_given[k] || !jac_pattern_[k]);
+  }
+  for (size_t k = 0; k < hes_given.size(); ++k) {
+    assert(hes_given[k] || !hes_pattern_[k]);
+  }
+  jac_pattern_ = jac_given;
+  hes_pattern_ = hes_given;
+#endif
+}
+
+void MPCTape::SelectEntries() {
+  size_t n_u = n_vars_ + n_params_;
+  size_t n_fg = 1 + n_constraints_;
+
+  // Only derivatives of the constraints with respect to vars are requested.
+  jac_rows_.clear();
+  jac_cols_.clear();
+  for (size_t i = 1; i < n_fg; ++i) {
+    for (size_t j = 0; j < n_vars_; ++j) {
+      if (jac_pattern_[i * n_u + j]) {
+        jac_rows_.push_back(i - 1);
+        jac_cols_.push_back(j);
+      }
+    }
+  }
+  // Lower triangle of the vars block of the Hessian.
+  hes_rows_.clear();
+  hes_cols_.clear();
+  for (size_t i = 0; i < n_vars_; ++i) {
+    for (size_t j = 0; j <= i; ++j) {
+      if (hes_pattern_[i * n_u + j]) {
+        hes_rows_.push_back(i);
+        hes_cols_.push_back(j);
+      }
+    }
+  }
+
+  jac_row_idx_.resize(jac_rows_.size());
+  jac_col_idx_.resize(jac_cols_.size());
+  for (size_t k = 0; k < jac_rows_.size(); ++k) {
+    jac_row_idx_[k] = jac_rows_[k] + 1;
+    jac_col_idx_[k] = jac_cols_[k];
+  }
+  hes_row_idx_.resize(hes_rows_.size());
+  hes_col_idx_.resize(hes_cols_.size());
+  for (size_t k = 0; k < hes_rows_.size(); ++k) {
+    hes_row_idx_[k] = hes_rows_[k];
+    hes_col_idx_[k] = hes_cols_[k];
+  }
+  jac_values_.resize(jac_rows_.size());
+  hes_values_.resize(hes_rows_.size());
+}
+
+void MPCTape::PrepareWork() {
+  // The first call of each sparse driver colors the pattern into its work
+  // object; the values at the recording point are thrown away.
+  jac_work_.clear();
+  hes_work_.clear();
+  fun_.SparseJacobianReverse(u_, jac_pattern_, jac_row_idx_, jac_col_idx_,
+                             jac_values_, jac_work_);
+  for (size_t i = 0; i < weights_.size(); ++i) {
+    weights_[i] = 1.0;
+  }
+  fun_.SparseHessian(u_, weights_, hes_pattern_, hes_row_idx_, hes_col_idx_,
+                     hes_values_, hes_work_);
+  fg_valid_ = false;
+}
+
+void MPCTape::SetParameters(const double* params) {
+  for (size_t i = 0; i < n_params_; ++i) {
+    u_[n_vars_ + i] = params[i];
+  }
+  fg_valid_ = false;
+}
+
+void MPCTape::Forward0(const double* x) {
+  if (fg_valid_) {
+    size_t i = 0;
+    while (i < n_vars_ && u_[i] == x[i]) {
+      ++i;
+    }
+    if (i == n_vars_) {
+      return;
+    }
+  }
+  for (size_t i = 0; i < n_vars_; ++i) {
+    u_[i] = x[i];
+  }
+  fg_ = fun_.Forward(0, u_);
+  fg_valid_ = true;
+}
+
+double MPCTape::EvalF(const double* x) {
+  Forward0(x);
+  return fg_[0];
+}
+
+void MPCTape::EvalG(const double* x, double* g) {
+  Forward0(x);
+  for (size_t i = 0; i < n_constraints_; ++i) {
+    g[i] = fg_[1 + i];
+  }
+}
+
+void MPCTape::EvalGradF(const double* x, double* grad_f) {
+  // The sparse drivers below leave other Taylor coefficients on the tape,
+  // so always redo the zero order sweep before the reverse one.
+  fg_valid_ = false;
+  Forward0(x);
+  for (size_t i = 0; i < reverse_weight_.size(); ++i) {
+    reverse_weight_[i] = 0.0;
+  }
+  reverse_weight_[0] = 1.0;
+  Dvector du = fun_.Reverse(1, reverse_weight_);
+  for (size_t i = 0; i < n_vars_; ++i) {
+    grad_f[i] = du[i];
+  }
+}
+
+void MPCTape::EvalJacG(const double* x, double* values) {
+  for (size_t i = 0; i < n_vars_; ++i) {
+    u_[i] = x[i];
+  }
+  fun_.SparseJacobianReverse(u_, jac_pattern_, jac_row_idx_, jac_col_idx_,
+                             jac_values_, jac_work_);
+  for (size_t k = 0; k < jac_values_.size(); ++k) {
+    values[k] = jac_values_[k];
+  }
+  fg_valid_ = false;
+}
+
+void MPCTape::EvalHesLag(const double* x, double obj_factor,
+                         const double* lambda, double* values) {
+  for (size_t i = 0; i < n_vars_; ++i) {
+    u_[i] = x[i];
+  }
+  weights_[0] = obj_factor;
+  for (size_t i = 0; i < n_constraints_; ++i) {
+    weights_[1 + i] = lambda[i];
+  }
+  fun_.SparseHessian(u_, weights_, hes_pattern_, hes_row_idx_, hes_col_idx_,
+                     hes_values_, hes_work_);
+  for (size_t k = 0; k < hes_values_.size(); ++k) {
+    values[k] = hes_values_[k];
+  }
+  fg_valid_ = false;
+}
@@ -0,0 +1,172 @@
+#ifndef MPC_TAPE_H
+#define MPC_TAPE_H
+
+#include <cppad/cppad.hpp>
+#include <utility>
+#include <vector>
+#include "MPCDerivatives.h"
+
+//
+// CppAD tape of the MPC cost and constraints.
+//
+// The tape is recorded once with the independent vector [vars, params]: the
+// optimizer variables followed by the problem parameters (the fitted
+// polynomial coefficients). The parameters are held fixed by every
+// evaluation below, so a new set of coefficients only needs SetParameters()
+// instead of a new recording. Derivatives are only taken with respect to
+// the leading `n_vars` entries.
+//
+class MPCTape : public MPCDerivatives {
+ public:
+  typedef CPPAD_TESTVECTOR(double) Dvector;
+  typedef CPPAD_TESTVECTOR(size_t) Svector;
+  typedef CPPAD_TESTVECTOR(CppAD::AD<double>) ADvector;
+  // (row, column) pairs of structural nonzeros.
+  typedef std::vector<std::pair<size_t, size_t> > Pattern;
+
+  MPCTape() {}
+
+  // Record `eval` once. `eval` must provide
+  // operator()(ADvector& fg, const ADvector& vars, const ADvector& params),
+  // with fg[0] the cost and fg[1..n_constraints] the constraints.
+  //
+  // The sparsity patterns are taken from the tape unless given: `jac` the
+  // Jacobian of fg and `hes` one triangle of the Hessian of any weighted sum
+  // of fg, both with respect to [vars, params] (see MPCSparsityT()). Given
+  // patterns must cover every nonzero of the tape. The colorings of the
+  // sparse drivers are computed here as well, so the first solve does not
+  // pay for them.
+  template <class Eval>
+  void Record(Eval &eval, size_t n_vars, size_t n_constraints,
+              size_t n_params, const Pattern *jac = NULL,
+              const Pattern *hes = NULL);
+
+  bool IsRecorded() const { return recorded_; }
+  size_t NumVars() const override { return n_vars_; }
+  size_t NumConstraints() const override { return n_constraints_; }
+  size_t NumParams() const { return n_params_; }
+
+  void SetParameters(const double* params) override;
+
+  double EvalF(const double* x) override;
+  void EvalG(const double* x, double* g) override;
+  void EvalGradF(const double* x, double* grad_f) override;
+  void EvalJacG(const double* x, double* values) override;
+  void EvalHesLag(const double* x, double obj_factor, const double* lambda,
+                  double* values) override;
+
+  // Entries of the patterns with respect to vars, in row major order.
+  const std::vector<size_t>& JacRows() const override { return jac_rows_; }
+  const std::vector<size_t>& JacCols() const override { return jac_cols_; }
+  const std::vector<size_t>& HesRows() const override { return hes_rows_; }
+  const std::vector<size_t>& HesCols() const override { return hes_cols_; }
+
+ private:
+  // Patterns of the full tape, from the tape or from the given entries.
+  void ComputeSparsity();
+  void SetSparsity(const Pattern &jac, const Pattern &hes);
+  // Requested entries of the patterns and the colorings of their drivers.
+  void SelectEntries();
+  void PrepareWork();
+  void Forward0(const double* x);
+
+  bool recorded_ = false;
+  size_t n_vars_ = 0;
+  size_t n_constraints_ = 0;
+  size_t n_params_ = 0;
+
+  CppAD::ADFun<double> fun_;
+
+  // Independent vector [vars, params] and result of the last zero order
+  // sweep.
+  Dvector u_;
+  Dvector fg_;
+  bool fg_valid_ = false;
+
+  // Sparsity patterns of the full tape and the requested entries.
+  CppAD::vectorBool jac_pattern_;
+  CppAD::vectorBool hes_pattern_;
+  Svector jac_row_idx_;  // rows of fg, i.e. shifted by one for the cost
+  Svector jac_col_idx_;
+  Svector hes_row_idx_;
+  Svector hes_col_idx_;
+  std::vector<size_t> jac_rows_;
+  std::vector<size_t> jac_cols_;
+  std::vector<size_t> hes_rows_;
+  std::vector<size_t> hes_cols_;
+
+  // Work buffers, sized once in Record().
+  Dvector jac_values_;
+  Dvector hes_values_;
+  Dvector weights_;
+  Dvector reverse_weight_;
+
+  // Colorings computed by PrepareWork(), reused by every call.
+  CppAD::sparse_jacobian_work jac_work_;
+  CppAD::sparse_hessian_work hes_work_;
+};
+
+// Let CppAD record and evaluate tapes on several threads at once, e.g. in
+// backends solving on a thread pool. Call on the main thread before any
+// other thread uses CppAD; later calls do nothing. Each thread is numbered
+// on its first use of CppAD and gives its number back when it exits, so at
+// most CPPAD_MAX_NUM_THREADS threads may use CppAD at the same time.
+void SetupCppADThreads();
+
+// Reserve CppAD thread numbers for up to `n` threads, e.g. the workers of a
+// thread pool that may all use CppAD, and return how many were reserved,
+// possibly 0. Pools sized by this never run out of numbers; a thread using
+// CppAD beyond the reservations and the main thread may, which ends the
+// process with a message. Give the numbers back with ReleaseCppADThreads()
+// once the threads have exited.
+size_t ReserveCppADThreads(size_t n);
+void ReleaseCppADThreads(size_t n);
+
+template <class Eval>
+void MPCTape::Record(Eval &eval, size_t n_vars, size_t n_constraints,
+                     size_t n_params, const Pattern *jac, const Pattern *hes) {
+  n_vars_ = n_vars;
+  n_constraints_ = n_constraints;
+  n_params_ = n_params;
+
+  size_t n_u = n_vars + n_params;
+  ADvector au(n_u);
+  for (size_t i = 0; i < n_u; ++i) {
+    au[i] = 0.0;
+  }
+  CppAD::Independent(au);
+
+  ADvector avars(n_vars);
+  ADvector aparams(n_params);
+  for (size_t i = 0; i < n_vars; ++i) {
+    avars[i] = au[i];
+  }
+  for (size_t i = 0; i < n_params; ++i) {
+    aparams[i] = au[n_vars + i];
+  }
+
+  ADvector afg(1 + n_constraints);
+  eval(afg, avars, aparams);
+
+  fun_.Dependent(au, afg);
+  fun_.optimize();
+
+  u_.resize(n_u);
+  for (size_t i = 0; i < n_u; ++i) {
+    u_[i] = 0.0;
+  }
+  fg_.resize(1 + n_constraints);
+  weights_.resize(1 + n_constraints);
+  reverse_weight_.resize(1 + n_constraints);
+
+  if (jac != NULL && hes != NULL) {
+    SetSparsity(*jac, *hes);
+  } else {
+    ComputeSparsity();
+  }
+  SelectEntries();
+  PrepareWork();
+  recorded_ = true;
+}
+
+#endif  // MPC_TAPE_H
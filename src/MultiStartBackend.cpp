@@ -0,0 +1,185 @@
+#include "MultiStartBackend.h"
+#include <algorithm>
+#include <thread>
+#include "MPCTape.h"
+
+using Eigen::VectorXd;
+
+MultiStartBackend::MultiStartBackend(const MPCLayout &layout,
+                                     const std::string &inner)
+    : SolverBackend(layout),
+      name_(inner + "-multistart"),
+      runs_(kNumStarts),
+      solution_(VectorXd::Zero(layout.n_vars)),
+      pool_(Pool()) {
+  for (Run &run : runs_) {
+    run.backend = MakeSolverBackend(inner, layout);
+  }
+}
+
+Eigen::NonBlockingThreadPool *MultiStartBackend::Pool() {
+  // Never destroyed: its workers may still use CppAD while the process
+  // exits.
+  static Eigen::NonBlockingThreadPool *pool = [] {
+    SetupCppADThreads();
+    size_t num_threads = ReserveCppADThreads(std::min<size_t>(
+        kNumStarts, std::max<size_t>(1, std::thread::hardware_concurrency())));
+    return num_threads > 0 ? new Eigen::NonBlockingThreadPool(num_threads)
+                           : nullptr;
+  }();
+  return pool;
+}
+
+MultiStartBackend::~MultiStartBackend() {
+  {
+    std::unique_lock<std::mutex> lock(mutex_);
+    finished_.wait(lock, [this] {
+      for (const Run &run : runs_) {
+        if (run.busy) {
+          return false;
+        }
+      }
+      return true;
+    });
+  }
+}
+
+void MultiStartBackend::ResetWarmStart() {
+  std::lock_guard<std::mutex> lock(mutex_);
+  has_solution_ = false;
+  reset_shifted_ = true;
+  last_start_ = kNumStarts;
+}
+
+void MultiStartBackend::Seed(Start start, const VectorXd &state,
+                             const VectorXd &coeffs, VectorXd &z) const {
+  if (start == kShifted) {
+    z = solution_;
+    ShiftMovesT(layout_, z.data() + layout_.delta_start);
+    ShiftMovesT(layout_, z.data() + layout_.a_start);
+  } else {
+    double delta = 0.0;
+    if (start == kSteerLeft) {
+      delta = std::min(ub[layout_.delta_start], max_delta);
+    } else if (start == kSteerRight) {
+      delta = std::max(lb[layout_.delta_start], -max_delta);
+    }
+    z.setZero(layout_.n_vars);
+    for (size_t m = 0; m < layout_.n_moves; ++m) {
+      z[layout_.delta_start + m] = delta;
+    }
+  }
+  SetStateAt(layout_, Vector6d(state), 0, z.data());
+  RolloutT(layout_, coeffs.data(), z.data());
+}
+
+void MultiStartBackend::RunStart(Run &run, const VectorXd &state,
+                                 const VectorXd &coeffs) {
+  bool ok = run.backend->Solve(state, coeffs);
+
+  std::lock_guard<std::mutex> lock(mutex_);
+  const SolverStats &stats = run.backend->Stats();
+  run.ok = ok;
+  run.cost = stats.cost;
+  run.iterations = stats.iterations;
+  run.deadline_hit = stats.deadline_hit;
+  run.solution = run.backend->Solution();
+  run.done = true;
+  run.busy = false;
+  finished_.notify_all();
+}
+
+bool MultiStartBackend::SolveImpl(const VectorXd &state,
+                                  const VectorXd &coeffs) {
+  std::unique_lock<std::mutex> lock(mutex_);
+
+  // Solves that missed an earlier deadline may still run. Start whatever
+  // is free, but at least one.
+  finished_.wait(lock, [this] {
+    for (const Run &run : runs_) {
+      if (!run.busy) {
+        return true;
+      }
+    }
+    return false;
+  });
+  std::vector<Run *> started;
+  for (int s = 0; s < kNumStarts; ++s) {
+    Run &run = runs_[s];
+    if (run.busy) {
+      continue;
+    }
+    SolverBackend &backend = *run.backend;
+    backend.lb = lb;
+    backend.ub = ub;
+    backend.deadline = deadline;
+    if (s == kShifted) {
+      if (reset_shifted_) {
+        backend.ResetWarmStart();
+        reset_shifted_ = false;
+      }
+      backend.use_warm_start = use_warm_start;
+      if (use_warm_start && has_solution_) {
+        Seed(kShifted, state, coeffs, backend.initial_guess);
+      } else if (static_cast<size_t>(initial_guess.size()) ==
+                 layout_.n_vars) {
+        backend.initial_guess = initial_guess;
+      } else {
+        backend.initial_guess.resize(0);
+      }
+    } else {
+      backend.use_warm_start = false;
+      Seed(static_cast<Start>(s), state, coeffs, backend.initial_guess);
+    }
+    run.busy = true;
+    run.done = false;
+    started.push_back(&run);
+  }
+  lock.unlock();
+
+  for (Run *run : started) {
+    pool_->Schedule(
+        [this, run, state, coeffs] { RunStart(*run, state, coeffs); });
+  }
+
+  lock.lock();
+  auto num_done = [&started] {
+    size_t n = 0;
+    for (const Run *run : started) {
+      n += run->done;
+    }
+    return n;
+  };
+  if (deadline.IsSet()) {
+    bool all_done = finished_.wait_until(lock, deadline.At(), [&] {
+      return num_done() == started.size();
+    });
+    if (!all_done) {
+      deadline_hit_ = true;
+      finished_.wait(lock, [&] { return num_done() > 0; });
+    }
+  } else {
+    finished_.wait(lock, [&] { return num_done() == started.size(); });
+  }
+
+  // Least cost among the feasible results, or among all if none is.
+  const Run *best = nullptr;
+  for (const Run *run : started) {
+    if (!run->done) {
+      continue;
+    }
+    if (!best || (run->ok && !best->ok) ||
+        (run->ok == best->ok && run->cost < best->cost)) {
+      best = run;
+    }
+  }
+  last_start_ = static_cast<Start>(best - &runs_[0]);
+  solution_ = best->solution;
+  last_iterations_ = best->iterations;
+  deadline_hit_ = deadline_hit_ || best->deadline_hit;
+  has_solution_ = best->ok;
+  if (last_start_ != kShifted) {
+    reset_shifted_ = true;
+  }
+  return best->ok;
+}
@@ -0,0 +1,103 @@
+#ifndef MULTI_START_BACKEND_H
+#define MULTI_START_BACKEND_H
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "Eigen-3.3/Eigen/Core"
+#include "Eigen-3.3/unsupported/Eigen/CXX11/ThreadPool"
+#include "SolverBackend.h"
+
+//
+// Several solves of the same problem from different starting points, run
+// concurrently on a thread pool, each by its own instance of another
+// backend. The starts are
+//
+//   - the previous solution shifted one step forward,
+//   - driving straight (zero actuations),
+//   - steering at the upper bound (left) and
+//   - steering at the lower bound (right),
+//
+// each rolled out from the measured state. The result is the feasible
+// solution of least cost among the solves that finished, waiting for all of
+// them, or until the deadline if one is set and then for the first one if
+// none has finished yet. Solves still running then keep their instance
+// busy and are left out of the following solves until they finish.
+//
+// The first start warm starts its backend (primal and dual variables) as
+// long as it wins; otherwise it starts from the shifted winner.
+//
+// All multi-start backends of the process share one pool of up to one
+// thread per start, so that creating backends, e.g. a vehicle or a horizon
+// each, does not use up CppAD thread numbers (see ReserveCppADThreads()).
+//
+// NOTE: the inner backends must be safe to run on different threads at
+// once. For Ipopt this needs an Ipopt that serializes its calls into MUMPS
+// (3.14 and later) or a thread-safe linear solver such as the HSL ones,
+// hence MPC_IPOPT_THREAD_SAFE in CMakeLists.txt.
+//
+class MultiStartBackend : public SolverBackend {
+ public:
+  // Solve with backends called `inner` (see MakeSolverBackend()) on the
+  // threads of Pool(), which must not be null.
+  MultiStartBackend(const MPCLayout &layout, const std::string &inner);
+  ~MultiStartBackend();
+
+  // Pool shared by all instances, created on the first call with one
+  // thread per start up to the number of cores. Null if no CppAD thread
+  // numbers were left for it.
+  static Eigen::NonBlockingThreadPool *Pool();
+
+  enum Start { kShifted, kStraight, kSteerLeft, kSteerRight, kNumStarts };
+
+  const char *Name() const override { return name_.c_str(); }
+  void ResetWarmStart() override;
+  const Eigen::VectorXd &Solution() const override { return solution_; }
+
+  // Start of the last solution, or kNumStarts if there is none.
+  Start LastStart() const { return last_start_; }
+
+ protected:
+  bool SolveImpl(const Eigen::VectorXd &state,
+                 const Eigen::VectorXd &coeffs) override;
+  int LastIterations() const override { return last_iterations_; }
+
+ private:
+  // One start and the result of its last solve.
+  struct Run {
+    std::unique_ptr<SolverBackend> backend;
+    bool busy = false;
+    bool done = false;
+    bool ok = false;
+    double cost = 0.0;
+    int iterations = -1;
+    bool deadline_hit = false;
+    Eigen::VectorXd solution;
+  };
+
+  // Starting point of `start` from `state`, in `z`.
+  void Seed(Start start, const Eigen::VectorXd &state,
+            const Eigen::VectorXd &coeffs, Eigen::VectorXd &z) const;
+  void RunStart(Run &run, const Eigen::VectorXd &state,
+                const Eigen::VectorXd &coeffs);
+
+  std::string name_;
+  std::vector<Run> runs_;
+
+  // Previous solution, for the shifted start.
+  Eigen::VectorXd solution_;
+  bool has_solution_ = false;
+  // The shifted start has to drop its own warm start before it runs next.
+  bool reset_shifted_ = false;
+  Start last_start_ = kNumStarts;
+  int last_iterations_ = -1;
+
+  // Guards runs_ against the workers.
+  std::mutex mutex_;
+  std::condition_variable finished_;
+  Eigen::NonBlockingThreadPool *pool_;
+};
+
+#endif  // MULTI_START_BACKEND_H
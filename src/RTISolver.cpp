@@ -0,0 +1,81 @@
+#include "RTISolver.h"
+#include <utility>
+
+using Eigen::VectorXd;
+
+RTISolver::RTISolver(const MPCLayout &layout,
+                     std::unique_ptr<MPCQPSolver> qp_solver,
+                     const std::string &name)
+    : SolverBackend(layout),
+      name_(name),
+      qp_(layout),
+      qp_solver_(std::move(qp_solver)),
+      z_(VectorXd::Zero(layout.n_vars)) {}
+
+void RTISolver::ResetWarmStart() {
+  z_.setZero();
+  has_solution_ = false;
+  prepared_ = false;
+}
+
+void RTISolver::Prepare() {
+  if (!use_warm_start || !has_solution_ || prepared_) {
+    return;
+  }
+  const MPCLayout &layout = qp_.layout;
+  ShiftMovesT(layout, z_.data() + layout.delta_start);
+  ShiftMovesT(layout, z_.data() + layout.a_start);
+
+  // The telemetry handler expresses everything in the vehicle frame, so the
+  // next frame starts at x = y = psi = 0 with the speed and errors the last
+  // solution predicts for its first step.
+  Vector6d s0 = StateAt(layout, z_.data(), 1);
+  s0[kX] = s0[kY] = s0[kPsi] = 0.0;
+  SetStateAt(layout, s0, 0, z_.data());
+  RolloutT(layout, coeffs_.data(), z_.data());
+
+  qp_.Linearize(z_.data(), coeffs_.data());
+  qp_solver_->Prepare(qp_);
+  prepared_ = true;
+}
+
+bool RTISolver::Feedback(const VectorXd &state, const VectorXd &coeffs) {
+  const MPCLayout &layout = qp_.layout;
+  if (prepared_) {
+    qp_.UpdateOffsets(z_.data(), coeffs.data());
+  } else {
+    // Nothing prepared (first frame or after a failure): linearize around
+    // the rollout from the measured state on the critical path.
+    if (!use_warm_start || !has_solution_) {
+      if (static_cast<size_t>(initial_guess.size()) == layout.n_vars) {
+        z_ = initial_guess;
+      } else {
+        z_.setZero();
+      }
+    }
+    SetStateAt(layout, state, 0, z_.data());
+    RolloutT(layout, coeffs.data(), z_.data());
+    qp_.Linearize(z_.data(), coeffs.data());
+    qp_solver_->Prepare(qp_);
+  }
+  qp_.x0 = state;
+
+  qp_solver_->deadline = deadline;
+  bool ok = qp_solver_->Solve(qp_, z_);
+  deadline_hit_ = qp_solver_->DeadlineHit();
+  prepared_ = false;
+  coeffs_ = coeffs;
+  has_solution_ = z_.allFinite();
+  if (!has_solution_) {
+    z_.setZero();
+    return false;
+  }
+  // Stopped by the deadline the plan is feasible, if not optimal.
+  return ok || deadline_hit_;
+}
+
+bool RTISolver::SolveImpl(const VectorXd &state, const VectorXd &coeffs) {
+  qp_.lb = lb;
+  qp_.ub = ub;
+  return Feedback(state, coeffs);
+}
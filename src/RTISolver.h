@@ -0,0 +1,65 @@
+#ifndef RTI_SOLVER_H
+#define RTI_SOLVER_H
+
+#include <memory>
+#include <string>
+#include "Eigen-3.3/Eigen/Core"
+#include "MPCProblem.h"
+#include "MPCQP.h"
+#include "SolverBackend.h"
+
+//
+// Real-time iteration (RTI) scheme for the MPC problem: one SQP step per
+// frame, split into two phases.
+//
+// Prepare() runs between frames. It shifts the last solution one step
+// forward, rolls the model out from the state it predicts for the next
+// frame, linearizes the dynamics around that trajectory and hands the QP to
+// the QP solver (which may factorize or condense it).
+//
+// Feedback() runs when telemetry arrives. It only updates the QP with the
+// measured state and the new polynomial coefficients and solves it once.
+// The new coefficients enter through the offsets c_t of the linearized
+// dynamics; A_t and B_t keep those of the previous coefficients until the
+// next Prepare().
+//
+// Solve() runs Feedback() with the bounds in lb and ub. Without
+// use_warm_start nothing is prepared, and every frame linearizes around the
+// rollout of zero actuations.
+//
+class RTISolver : public SolverBackend {
+ public:
+  // `name` is the one it is registered under in MakeSolverBackend(), which
+  // tells the QP solvers apart.
+  RTISolver(const MPCLayout &layout, std::unique_ptr<MPCQPSolver> qp_solver,
+            const std::string &name = "rti");
+
+  const char *Name() const override { return name_.c_str(); }
+  void ResetWarmStart() override;
+  void Prepare() override;
+  const Eigen::VectorXd &Solution() const override { return z_; }
+
+  MPCQP &qp() { return qp_; }
+
+  bool Feedback(const Eigen::VectorXd &state, const Eigen::VectorXd &coeffs);
+
+ protected:
+  bool SolveImpl(const Eigen::VectorXd &state,
+                 const Eigen::VectorXd &coeffs) override;
+  int LastIterations() const override {
+    return qp_solver_->LastIterations();
+  }
+
+ private:
+  std::string name_;
+  MPCQP qp_;
+  std::unique_ptr<MPCQPSolver> qp_solver_;
+
+  // Last solution, after Prepare() the linearization trajectory.
+  Eigen::VectorXd z_;
+  Eigen::VectorXd coeffs_;
+  bool has_solution_ = false;
+  bool prepared_ = false;
+};
+
+#endif  // RTI_SOLVER_H
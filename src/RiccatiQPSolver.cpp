@@ -0,0 +1,501 @@
+#include "RiccatiQPSolver.h"
+#include <algorithm>
+#include <cmath>
+
+using Eigen::Matrix2d;
+using Eigen::Vector2d;
+using Eigen::VectorXd;
+
+template <typename Scalar>
+void RiccatiQPSolverT<Scalar>::Prepare(const MPCQP &qp) {
+  const MPCLayout &layout = qp.layout;
+  const size_t N = layout.N;
+  const size_t u_starts[] = {layout.delta_start, layout.a_start};
+
+  Q_.resize(N);
+  S_.resize(N - 1);
+  R_.resize(N - 1);
+  P_.resize(N - 1, Matrix2d::Zero());
+  for (size_t t = 0; t < N; ++t) {
+    for (size_t i = 0; i < 6; ++i) {
+      for (size_t j = 0; j < 6; ++j) {
+        Q_[t](i, j) = qp.H(layout.StateStart(i) + t, layout.StateStart(j) + t);
+      }
+    }
+    if (t + 1 == N) {
+      break;
+    }
+    for (size_t j = 0; j < 2; ++j) {
+      for (size_t i = 0; i < 6; ++i) {
+        S_[t](i, j) = qp.H(layout.StateStart(i) + t, u_starts[j] + t);
+      }
+      for (size_t i = 0; i < 2; ++i) {
+        R_[t](i, j) = qp.H(u_starts[i] + t, u_starts[j] + t);
+        if (t + 2 < N) {
+          P_[t](i, j) = qp.H(u_starts[i] + t, u_starts[j] + t + 1);
+        }
+      }
+    }
+  }
+
+  recursion_.Resize(N);
+  if (max_refinements > 0) {
+    recursion_double_.Resize(N);
+  }
+}
+
+template <typename Scalar>
+template <typename T>
+void RiccatiQPSolverT<Scalar>::Recursion<T>::Resize(size_t N) {
+  A.resize(N - 1);
+  B.resize(N - 1);
+  V.resize(N);
+  K.resize(N - 1);
+  Quu.resize(N - 1);
+  Quy.resize(N - 1);
+  Qup.resize(N - 1);
+  k.resize(N - 1);
+}
+
+template <typename Scalar>
+template <typename T>
+void RiccatiQPSolverT<Scalar>::Factor(const MPCQP &qp,
+                                      Recursion<T> &recursion) {
+  typedef typename Recursion<T>::Matrix2 Matrix2;
+  typedef typename Recursion<T>::Matrix6 Matrix6;
+  typedef typename Recursion<T>::Matrix62 Matrix62;
+  typedef typename Recursion<T>::Matrix8 Matrix8;
+  typedef typename Recursion<T>::Matrix28 Matrix28;
+  // The augmented dynamics y_{t+1} = [A_t 0; 0 0] y_t + [B_t; I] u_t + c_t
+  // are written out blockwise below, with V = [Vss Vsu; Vus Vuu].
+  const size_t N = qp.layout.N;
+  recursion.V[N - 1].setZero();
+  recursion.V[N - 1].template topLeftCorner<6, 6>() =
+      Q_[N - 1].template cast<T>();
+  for (size_t t = N - 1; t-- > 0;) {
+    recursion.A[t] = qp.A[t].template cast<T>();
+    recursion.B[t] = qp.B[t].template cast<T>();
+    const Matrix6 &A = recursion.A[t];
+    const Matrix62 &B = recursion.B[t];
+    const Matrix8 &V = recursion.V[t + 1];
+    Matrix62 W = V.template topLeftCorner<6, 6>() * B +
+                 V.template topRightCorner<6, 2>();
+
+    Matrix2 Quu = R_[t].template cast<T>() + B.transpose() * W +
+                  V.template bottomLeftCorner<2, 6>() * B +
+                  V.template bottomRightCorner<2, 2>();
+    Quu(0, 0) += T(D_[t]);
+    Quu(1, 1) += T(D_[N - 1 + t]);
+    Matrix28 Quy;
+    Quy.template leftCols<6>() =
+        W.transpose() * A + S_[t].transpose().template cast<T>();
+    if (t > 0) {
+      Quy.template rightCols<2>() = P_[t - 1].transpose().template cast<T>();
+    } else {
+      Quy.template rightCols<2>().setZero();
+    }
+    recursion.Quy[t] = Quy;
+    // A pinned actuation gets no feedback; its columns of Quu move the
+    // feedforward terms of the other in SolveLQ().
+    recursion.Qup[t].setZero();
+    for (size_t j = 0; j < 2; ++j) {
+      if (pinned_[j * (N - 1) + t]) {
+        recursion.Qup[t].col(j) = Quu.col(j);
+        Quu.row(j).setZero();
+        Quu.col(j).setZero();
+        Quu(j, j) = T(1);
+        Quy.row(j).setZero();
+      }
+    }
+
+    recursion.Quu[t].compute(Quu);
+    recursion.K[t] = -recursion.Quu[t].solve(Quy);
+    Matrix8 Vt = Quy.transpose() * recursion.K[t];
+    Vt.template topLeftCorner<6, 6>() +=
+        Q_[t].template cast<T>() +
+        A.transpose() * V.template topLeftCorner<6, 6>() * A;
+    recursion.V[t] = T(0.5) * (Vt + Vt.transpose());
+  }
+}
+
+template <typename Scalar>
+template <typename T>
+void RiccatiQPSolverT<Scalar>::SolveLQ(const MPCQP &qp,
+                                       Recursion<T> &recursion,
+                                       const VectorXd &g, VectorXd &z,
+                                       bool homogeneous) {
+  typedef typename Recursion<T>::Vector2 Vector2;
+  typedef typename Recursion<T>::Vector8 Vector8;
+  typedef typename Recursion<T>::Matrix8 Matrix8;
+  typedef Eigen::Matrix<double, 8, 1> Vector8d;
+  const MPCLayout &layout = qp.layout;
+  const size_t N = layout.N;
+  // Value of actuation j of step t if pinned, zero otherwise.
+  auto pinned_value = [&](size_t j, size_t t) {
+    size_t i = j * (N - 1) + t;
+    return pinned_[i] && !homogeneous ? qp.lb[layout.delta_start + i] : 0.0;
+  };
+
+  // Backward sweep of the linear terms: v is the cost-to-go gradient of
+  // y_{t+1}.
+  Vector8 v = Vector8::Zero();
+  v.template head<6>() = StateAt(layout, g.data(), N - 1).template cast<T>();
+  for (size_t t = N - 1; t-- > 0;) {
+    const Matrix8 &V = recursion.V[t + 1];
+    Vector8 Vc = v;
+    if (!homogeneous) {
+      Vc += V.template leftCols<6>() * qp.c[t].template cast<T>();
+    }
+
+    Vector2 qu = qp.ActuationAt(g.data(), t).template cast<T>() +
+                 recursion.B[t].transpose() * Vc.template head<6>() +
+                 Vc.template tail<2>();
+    Vector8 qy;
+    qy.template head<6>() =
+        StateAt(layout, g.data(), t).template cast<T>() +
+        recursion.A[t].transpose() * Vc.template head<6>();
+    qy.template tail<2>().setZero();
+    // With pinned actuations up the others minimize over the rest, and
+    // k[t] holds up itself.
+    Vector2 up(T(pinned_value(0, t)), T(pinned_value(1, t)));
+    qu += recursion.Qup[t] * up;
+    for (size_t j = 0; j < 2; ++j) {
+      if (pinned_[j * (N - 1) + t]) {
+        qu[j] = -up[j];
+      }
+    }
+    recursion.k[t] = -recursion.Quu[t].solve(qu);
+    v = qy + recursion.Quy[t].transpose() * recursion.k[t];
+  }
+
+  // Forward sweep from the initial state, in double.
+  Vector8d y = Vector8d::Zero();
+  if (!homogeneous) {
+    y.head<6>() = qp.x0;
+  }
+  SetStateAt(layout, y.head<6>(), 0, z.data());
+  for (size_t t = 0; t + 1 < N; ++t) {
+    Vector2d u = recursion.K[t].template cast<double>() * y +
+                 recursion.k[t].template cast<double>();
+    for (size_t j = 0; j < 2; ++j) {
+      if (pinned_[j * (N - 1) + t]) {
+        u[j] = pinned_value(j, t);
+      }
+    }
+    z[layout.delta_start + t] = u[0];
+    z[layout.a_start + t] = u[1];
+    Vector6d s = qp.A[t] * y.head<6>() + qp.B[t] * u;
+    if (!homogeneous) {
+      s += qp.c[t];
+    }
+    SetStateAt(layout, s, t + 1, z.data());
+    y << s, u;
+  }
+}
+
+template <typename Scalar>
+void RiccatiQPSolverT<Scalar>::Factor(const MPCQP &qp) {
+  if (in_double_) {
+    Factor(qp, recursion_double_);
+  } else {
+    Factor(qp, recursion_);
+  }
+}
+
+template <typename Scalar>
+void RiccatiQPSolverT<Scalar>::SolveLQ(const MPCQP &qp, const VectorXd &g,
+                                       VectorXd &z) {
+  if (in_double_) {
+    SolveLQ(qp, recursion_double_, g, z);
+  } else {
+    SolveLQ(qp, recursion_, g, z);
+  }
+}
+
+template <typename Scalar>
+bool RiccatiQPSolverT<Scalar>::Refine(const MPCQP &qp, const VectorXd &g,
+                                      VectorXd &z) {
+  const MPCLayout &layout = qp.layout;
+  const size_t N = layout.N;
+  double last_residual = INFINITY;
+  for (int r = 0; r <= max_refinements; ++r) {
+    // Gradient (H + diag(D_)) z + g, blockwise.
+    gradient_ = g;
+    for (size_t t = 0; t < N; ++t) {
+      Vector6d s = StateAt(layout, z.data(), t);
+      Vector6d gs = Q_[t] * s;
+      if (t + 1 < N) {
+        Vector2d u = qp.ActuationAt(z.data(), t);
+        gs += S_[t] * u;
+        Vector2d gu = S_[t].transpose() * s + R_[t] * u;
+        gu[0] += D_[t] * u[0];
+        gu[1] += D_[N - 1 + t] * u[1];
+        if (t + 2 < N) {
+          gu += P_[t] * qp.ActuationAt(z.data(), t + 1);
+        }
+        if (t > 0) {
+          gu += P_[t - 1].transpose() * qp.ActuationAt(z.data(), t - 1);
+        }
+        gradient_[layout.delta_start + t] += gu[0];
+        gradient_[layout.a_start + t] += gu[1];
+      }
+      SetStateAt(layout, StateAt(layout, gradient_.data(), t) + gs, t,
+                 gradient_.data());
+    }
+
+    // Gradient over the free actuations of the problem with the states
+    // eliminated, by an adjoint sweep: lambda is the gradient of s_{t+1}.
+    for (size_t i = 0; i < pinned_.size(); ++i) {
+      if (pinned_[i]) {
+        gradient_[layout.delta_start + i] = 0.0;
+      }
+    }
+    Vector6d lambda = StateAt(layout, gradient_.data(), N - 1);
+    double residual = 0.0;
+    for (size_t t = N - 1; t-- > 0;) {
+      Vector2d ru = qp.ActuationAt(gradient_.data(), t) +
+                    qp.B[t].transpose() * lambda;
+      residual = std::max(residual, ru.lpNorm<Eigen::Infinity>());
+      lambda = StateAt(layout, gradient_.data(), t) +
+               qp.A[t].transpose() * lambda;
+    }
+    if (residual <= refinement_tolerance *
+                        std::max(1.0, gradient_.lpNorm<Eigen::Infinity>())) {
+      return true;
+    }
+    if (r == max_refinements || residual > 0.5 * last_residual) {
+      return false;
+    }
+    last_residual = residual;
+
+    // The correction minimizes the quadratic model around z under the
+    // homogeneous dynamics.
+    correction_.resize(z.size());
+    SolveLQ(qp, recursion_, gradient_, correction_, true);
+    z += correction_;
+  }
+  return true;
+}
+
+template <typename Scalar>
+void RiccatiQPSolverT<Scalar>::StepLengths(const VectorXd &dz,
+                                           const VectorXd &dml,
+                                           const VectorXd &dmu,
+                                           double fraction,
+                                           double &alpha_primal,
+                                           double &alpha_dual) const {
+  alpha_primal = 1.0;
+  alpha_dual = 1.0;
+  for (int i = 0; i < dz.size(); ++i) {
+    if (HasBound(lb_[i])) {
+      if (dz[i] < 0.0) {
+        alpha_primal = std::min(alpha_primal, -fraction * sl_[i] / dz[i]);
+      }
+      if (dml[i] < 0.0) {
+        alpha_dual = std::min(alpha_dual, -fraction * ml_[i] / dml[i]);
+      }
+    }
+    if (HasBound(ub_[i])) {
+      if (dz[i] > 0.0) {
+        alpha_primal = std::min(alpha_primal, fraction * su_[i] / dz[i]);
+      }
+      if (dmu[i] < 0.0) {
+        alpha_dual = std::min(alpha_dual, -fraction * mu_[i] / dmu[i]);
+      }
+    }
+  }
+}
+
+template <typename Scalar>
+bool RiccatiQPSolverT<Scalar>::Solve(const MPCQP &qp, VectorXd &z) {
+  const MPCLayout &layout = qp.layout;
+  const size_t ns = layout.delta_start;
+  const size_t nu = layout.n_vars - ns;
+
+  // Strictly interior start: the actuations of `z` moved off their bounds,
+  // the states from the dynamics.
+  lb_ = qp.lb.tail(nu);
+  ub_ = qp.ub.tail(nu);
+  sl_.setZero(nu);
+  su_.setZero(nu);
+  ml_.setZero(nu);
+  mu_.setZero(nu);
+  pinned_.assign(nu, false);
+  size_t num_bounds = 0;
+  for (size_t i = 0; i < nu; ++i) {
+    if (lb_[i] == ub_[i]) {
+      // Pinned, as by MPC::SetBounds with LATENCY_HANDLING: held at the
+      // bound, with no slack to keep positive.
+      pinned_[i] = true;
+      z[ns + i] = lb_[i];
+      lb_[i] = -1.0e19;
+      ub_[i] = 1.0e19;
+      continue;
+    }
+    bool lower = HasBound(lb_[i]);
+    bool upper = HasBound(ub_[i]);
+    double margin = lower && upper ? 0.01 * (ub_[i] - lb_[i]) : 0.01;
+    double u = z[ns + i];
+    if (lower) {
+      u = std::max(u, lb_[i] + margin);
+    }
+    if (upper) {
+      u = std::min(u, ub_[i] - margin);
+    }
+    z[ns + i] = u;
+    if (lower) {
+      sl_[i] = u - lb_[i];
+      ml_[i] = 1.0;
+      ++num_bounds;
+    }
+    if (upper) {
+      su_[i] = ub_[i] - u;
+      mu_[i] = 1.0;
+      ++num_bounds;
+    }
+  }
+  qp.Rollout(z.data());
+
+  D_.setZero(nu);
+  z_step_.resize(z.size());
+  if (num_bounds == 0) {
+    // An equality constrained QP, solved by a single sweep.
+    in_double_ = false;
+    Factor(qp);
+    SolveLQ(qp, qp.q, z);
+    if (max_refinements > 0 && !Refine(qp, qp.q, z)) {
+      in_double_ = true;
+      Factor(qp);
+      SolveLQ(qp, qp.q, z);
+    }
+    last_iterations_ = 1;
+    deadline_hit_ = false;
+    return true;
+  }
+
+  // Complementarity of the current iterate.
+  auto complementarity = [&]() {
+    return (sl_.dot(ml_) + su_.dot(mu_)) / num_bounds;
+  };
+  // Multiplier steps for the actuation step dz and the complementarity
+  // targets rl, ru.
+  auto multiplier_steps = [&](const VectorXd &dz, const VectorXd &rl,
+                              const VectorXd &ru, VectorXd &dml,
+                              VectorXd &dmu) {
+    dml.setZero(nu);
+    dmu.setZero(nu);
+    for (size_t i = 0; i < nu; ++i) {
+      if (HasBound(lb_[i])) {
+        dml[i] = (rl[i] - ml_[i] * dz[i]) / sl_[i];
+      }
+      if (HasBound(ub_[i])) {
+        dmu[i] = (ru[i] + mu_[i] * dz[i]) / su_[i];
+      }
+    }
+  };
+
+  VectorXd rl(nu), ru(nu);
+  bool converged = false;
+  in_double_ = false;
+  deadline_hit_ = false;
+  for (last_iterations_ = 0; last_iterations_ < max_iterations;) {
+    // The iterate satisfies the dynamics and lies inside the bounds: it is
+    // the plan if the deadline stops the solve here.
+    if (deadline.Near(deadline_reserve_ms)) {
+      deadline_hit_ = true;
+      break;
+    }
+    ++last_iterations_;
+    double mu = complementarity();
+
+    // Barrier Hessian of the bounds, shared by both steps.
+    for (size_t i = 0; i < nu; ++i) {
+      D_[i] = (HasBound(lb_[i]) ? ml_[i] / sl_[i] : 0.0) +
+              (HasBound(ub_[i]) ? mu_[i] / su_[i] : 0.0);
+    }
+    Factor(qp);
+
+    // Predictor: the Newton step towards zero complementarity. With these
+    // targets the linear term of the bounds cancels.
+    g_ = qp.q;
+    g_.tail(nu) -= D_.cwiseProduct(z.tail(nu));
+    SolveLQ(qp, g_, z_step_);
+    dz_aff_ = z_step_.tail(nu) - z.tail(nu);
+    rl = -sl_.cwiseProduct(ml_);
+    ru = -su_.cwiseProduct(mu_);
+    multiplier_steps(dz_aff_, rl, ru, dml_aff_, dmu_aff_);
+    double alpha_primal, alpha_dual;
+    StepLengths(dz_aff_, dml_aff_, dmu_aff_, 1.0, alpha_primal, alpha_dual);
+    double mu_aff = 0.0;
+    for (size_t i = 0; i < nu; ++i) {
+      if (HasBound(lb_[i])) {
+        mu_aff += (sl_[i] + alpha_primal * dz_aff_[i]) *
+                  (ml_[i] + alpha_dual * dml_aff_[i]);
+      }
+      if (HasBound(ub_[i])) {
+        mu_aff += (su_[i] - alpha_primal * dz_aff_[i]) *
+                  (mu_[i] + alpha_dual * dmu_aff_[i]);
+      }
+    }
+    mu_aff /= num_bounds;
+    double sigma = std::pow(mu_aff / mu, 3);
+
+    // Corrector: centering towards sigma mu, with the second order term of
+    // the predictor.
+    for (size_t i = 0; i < nu; ++i) {
+      rl[i] = HasBound(lb_[i]) ? sigma * mu - sl_[i] * ml_[i] -
+                                     dz_aff_[i] * dml_aff_[i]
+                               : 0.0;
+      ru[i] = HasBound(ub_[i]) ? sigma * mu - su_[i] * mu_[i] +
+                                     dz_aff_[i] * dmu_aff_[i]
+                               : 0.0;
+    }
+    g_ = qp.q;
+    for (size_t i = 0; i < nu; ++i) {
+      double w = 0.0;
+      if (HasBound(lb_[i])) {
+        w += ml_[i] + rl[i] / sl_[i];
+      }
+      if (HasBound(ub_[i])) {
+        w -= mu_[i] + ru[i] / su_[i];
+      }
+      g_[ns + i] -= D_[i] * z[ns + i] + w;
+    }
+    SolveLQ(qp, g_, z_step_);
+    if (max_refinements > 0 && !in_double_ && !Refine(qp, g_, z_step_)) {
+      in_double_ = true;
+      Factor(qp);
+      SolveLQ(qp, g_, z_step_);
+    }
+    dz_ = z_step_.tail(nu) - z.tail(nu);
+    multiplier_steps(dz_, rl, ru, dml_, dmu_);
+    StepLengths(dz_, dml_, dmu_, boundary_fraction, alpha_primal,
+                alpha_dual);
+
+    // The dynamics are linear, so every point between z and z_step_
+    // satisfies them.
+    double step = alpha_primal * (z_step_ - z).lpNorm<Eigen::Infinity>();
+    z += alpha_primal * (z_step_ - z);
+    sl_ += alpha_primal * dz_;
+    su_ -= alpha_primal * dz_;
+    ml_ += alpha_dual * dml_;
+    mu_ += alpha_dual * dmu_;
+    for (size_t i = 0; i < nu; ++i) {
+      if (!HasBound(lb_[i])) {
+        sl_[i] = 0.0;
+      }
+      if (!HasBound(ub_[i])) {
+        su_[i] = 0.0;
+      }
+    }
+
+    if (complementarity() < mu_tolerance && step < step_tolerance) {
+      converged = true;
+      break;
+    }
+  }
+  return converged;
+}
+
+template class RiccatiQPSolverT<double>;
+template class RiccatiQPSolverT<float>;
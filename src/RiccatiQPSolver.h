@@ -0,0 +1,151 @@
+#ifndef RICCATI_QP_SOLVER_H
+#define RICCATI_QP_SOLVER_H
+
+#include <type_traits>
+#include <vector>
+#include "Eigen-3.3/Eigen/Cholesky"
+#include "Eigen-3.3/Eigen/Core"
+#include "MPCQP.h"
+
+//
+// Primal-dual interior point solver of MPCQP (Mehrotra predictor-corrector)
+// that solves its KKT systems with a Riccati recursion over the N steps
+// instead of a general sparse factorization.
+//
+// The bounds of the actuations enter the KKT system as a positive diagonal
+// added to H, which keeps the stage structure: the cost couples the state
+// and actuation of a step and, through the rate penalty, consecutive
+// actuations. As in ILQRSolver the recursion therefore runs on the state
+// augmented with the previous actuation, y_t = (s_t, u_{t-1}), of dimension
+// 8. Each iteration factors the recursion once (8x8 and 2x2 blocks per
+// step, so linear in N, with no fill-in or pivoting) and runs its forward
+// and backward sweeps twice, for the predictor and the corrector step.
+//
+// Every iterate satisfies the dynamics and lies strictly inside the
+// actuation bounds. Only the actuation bounds in lb and ub are used, like
+// CondensedQPSolver, and an actuation with equal bounds is held at them,
+// out of the barrier, while the recursion solves for the others. H may
+// couple states and actuations of the same step and actuations of
+// neighbouring steps only, as the cost of FG_evalT does, and move blocking
+// is not supported. Nothing is kept between solves:
+// interior point iterates make poor warm starts.
+//
+// Scalar is the precision of the recursion. The forward sweep, which
+// applies the gains to the dynamics, always runs in double, so iterates
+// satisfy the dynamics to double precision either way. With float the
+// step that is taken (not the predictor, which only sets the centering) is
+// refined in double: the gradient of the reduced problem over the
+// actuations is evaluated with an adjoint sweep in double, and while it is
+// above refinement_tolerance, relative to the gradient of the full
+// problem, the recursion solves for a correction. Close to the solution
+// the barrier terms make the recursion too ill-conditioned for float; once
+// a correction fails to halve the gradient the rest of the solve factors
+// in double.
+//
+template <typename Scalar>
+class RiccatiQPSolverT : public MPCQPSolver {
+ public:
+  int max_iterations = 30;
+  // Stop once the average complementarity and the last step are below
+  // these.
+  double mu_tolerance = 1.0e-8;
+  double step_tolerance = 1.0e-6;
+  // Fraction of the way to the bounds taken at most.
+  double boundary_fraction = 0.995;
+  // Corrections of a step at most; none in double.
+  int max_refinements = std::is_same<Scalar, double>::value ? 0 : 3;
+  double refinement_tolerance = 1.0e-9;
+
+  void Prepare(const MPCQP &qp) override;
+  bool Solve(const MPCQP &qp, Eigen::VectorXd &z) override;
+
+ private:
+  // Recursion in precision T: the dynamics, the cost-to-go Hessians V[t]
+  // of y_t, the feedback gains K[t], the factors of the actuation
+  // Hessians and the cross terms Quy[t] of every step, the columns Qup[t]
+  // of the actuation Hessians of pinned actuations, and the feedforward
+  // terms k[t] of the last sweep. The actuation Hessians are factored with
+  // the rows and columns of pinned actuations replaced by the identity.
+  template <typename T>
+  struct Recursion {
+    typedef Eigen::Matrix<T, 2, 1> Vector2;
+    typedef Eigen::Matrix<T, 8, 1> Vector8;
+    typedef Eigen::Matrix<T, 2, 2> Matrix2;
+    typedef Eigen::Matrix<T, 6, 6> Matrix6;
+    typedef Eigen::Matrix<T, 6, 2> Matrix62;
+    typedef Eigen::Matrix<T, 8, 8> Matrix8;
+    typedef Eigen::Matrix<T, 2, 8> Matrix28;
+
+    void Resize(size_t N);
+
+    std::vector<Matrix6, Eigen::aligned_allocator<Matrix6> > A;
+    std::vector<Matrix62, Eigen::aligned_allocator<Matrix62> > B;
+    std::vector<Matrix8, Eigen::aligned_allocator<Matrix8> > V;
+    std::vector<Matrix28, Eigen::aligned_allocator<Matrix28> > K;
+    std::vector<Eigen::LLT<Matrix2>,
+                Eigen::aligned_allocator<Eigen::LLT<Matrix2> > >
+        Quu;
+    std::vector<Matrix28, Eigen::aligned_allocator<Matrix28> > Quy;
+    std::vector<Matrix2, Eigen::aligned_allocator<Matrix2> > Qup;
+    std::vector<Vector2, Eigen::aligned_allocator<Vector2> > k;
+  };
+
+  // Factor `recursion` for the diagonal D_ of the actuation bounds.
+  template <typename T>
+  void Factor(const MPCQP &qp, Recursion<T> &recursion);
+  // Minimize 0.5 z'(H + diag(D_))z + g'z subject to the dynamics, with
+  // `recursion` as last factored, writing the minimizer into `z`. With
+  // `homogeneous` the dynamics have no offsets and start at zero, as for
+  // a correction, and pinned actuations are held at zero.
+  template <typename T>
+  void SolveLQ(const MPCQP &qp, Recursion<T> &recursion,
+               const Eigen::VectorXd &g, Eigen::VectorXd &z,
+               bool homogeneous = false);
+  // Factor and solve with the recursion of the current precision.
+  void Factor(const MPCQP &qp);
+  void SolveLQ(const MPCQP &qp, const Eigen::VectorXd &g, Eigen::VectorXd &z);
+  // Refine the minimizer `z` of SolveLQ() for `g` in double. Returns false
+  // if a correction stalled above the tolerance.
+  bool Refine(const MPCQP &qp, const Eigen::VectorXd &g, Eigen::VectorXd &z);
+
+  // Largest step in (0, 1] along (dz, dml, dmu) keeping the slacks and the
+  // multipliers positive, for primal (first) and dual (second) variables.
+  void StepLengths(const Eigen::VectorXd &dz, const Eigen::VectorXd &dml,
+                   const Eigen::VectorXd &dmu, double fraction,
+                   double &alpha_primal, double &alpha_dual) const;
+
+  // Stage blocks of H: Q_[t] of the states, S_[t] between the states and
+  // the actuations, R_[t] of the actuations of step t, and P_[t] between
+  // the actuations of steps t and t + 1. In double, for the refinement.
+  std::vector<Matrix6d, Eigen::aligned_allocator<Matrix6d> > Q_;
+  std::vector<Matrix62d, Eigen::aligned_allocator<Matrix62d> > S_;
+  std::vector<Eigen::Matrix2d, Eigen::aligned_allocator<Eigen::Matrix2d> >
+      R_;
+  std::vector<Eigen::Matrix2d, Eigen::aligned_allocator<Eigen::Matrix2d> >
+      P_;
+  Recursion<Scalar> recursion_;
+  // Used instead of recursion_ for the rest of a solve in float once the
+  // refinement stalled.
+  Recursion<double> recursion_double_;
+  bool in_double_ = false;
+
+  // Actuation bounds, their slacks and multipliers in the order of the
+  // actuations in z; zero multipliers for absent bounds. Pinned
+  // actuations, with equal bounds in the QP, have none here.
+  std::vector<bool> pinned_;
+  Eigen::VectorXd lb_, ub_;
+  Eigen::VectorXd sl_, su_, ml_, mu_;
+  Eigen::VectorXd D_;
+  Eigen::VectorXd g_;
+  Eigen::VectorXd z_step_;
+  Eigen::VectorXd dz_aff_, dml_aff_, dmu_aff_;
+  Eigen::VectorXd dz_, dml_, dmu_;
+  // Gradient and correction of the refinement.
+  Eigen::VectorXd gradient_, correction_;
+};
+
+typedef RiccatiQPSolverT<double> RiccatiQPSolver;
+// Recursion in float, refined in double.
+typedef RiccatiQPSolverT<float> RiccatiQPSolverF;
+
+#endif  // RICCATI_QP_SOLVER_H
@@ -0,0 +1,76 @@
+#include "SolutionCache.h"
+#include <cmath>
+#include <functional>
+
+void SolutionCache::Configure(const Options &options) {
+  options_ = options;
+  Clear();
+}
+
+size_t SolutionCache::KeyHash::operator()(const Key &key) const {
+  size_t hash = 0;
+  for (int64_t k : key) {
+    hash ^= std::hash<int64_t>()(k) + 0x9e3779b97f4a7c15ull + (hash << 6) +
+            (hash >> 2);
+  }
+  return hash;
+}
+
+SolutionCache::Key SolutionCache::MakeKey(
+    const Eigen::VectorXd &state, const Eigen::VectorXd &coeffs) const {
+  Key key;
+  for (size_t i = 0; i < 6; ++i) {
+    key[i] = std::llround(state[i] / options_.state_tolerance[i]);
+  }
+  for (size_t i = 0; i < 4; ++i) {
+    key[6 + i] = std::llround(coeffs[i] / options_.coeffs_tolerance[i]);
+  }
+  return key;
+}
+
+const Eigen::VectorXd *SolutionCache::Find(const Eigen::VectorXd &state,
+                                           const Eigen::VectorXd &coeffs) {
+  ++stats_.lookups;
+  auto it = index_.find(MakeKey(state, coeffs));
+  if (it == index_.end()) {
+    return nullptr;
+  }
+  ++stats_.hits;
+  entries_.splice(entries_.begin(), entries_, it->second);
+  return &it->second->solution;
+}
+
+void SolutionCache::Insert(const Eigen::VectorXd &state,
+                           const Eigen::VectorXd &coeffs,
+                           const Eigen::VectorXd &solution) {
+  if (!Enabled()) {
+    return;
+  }
+  Key key = MakeKey(state, coeffs);
+  auto it = index_.find(key);
+  if (it != index_.end()) {
+    it->second->solution = solution;
+    entries_.splice(entries_.begin(), entries_, it->second);
+    return;
+  }
+  if (entries_.size() >= options_.capacity) {
+    index_.erase(entries_.back().key);
+    entries_.pop_back();
+  }
+  entries_.push_front(Entry{key, solution});
+  index_[key] = entries_.begin();
+}
+
+void SolutionCache::Clear() {
+  entries_.clear();
+  index_.clear();
+}
+
+void SolutionCache::RecordSolve(bool hit, double solve_ms) {
+  if (!hit) {
+    ++num_misses_;
+    stats_.miss_solve_ms += (solve_ms - stats_.miss_solve_ms) / num_misses_;
+  } else {
+    stats_.saved_ms += stats_.miss_solve_ms - solve_ms;
+  }
+}
@@ -0,0 +1,86 @@
+#ifndef SOLUTION_CACHE_H
+#define SOLUTION_CACHE_H
+
+#include <stdint.h>
+#include <array>
+#include <cstddef>
+#include <list>
+#include <unordered_map>
+#include "Eigen-3.3/Eigen/Core"
+
+//
+// Least recently used cache of MPC solutions, keyed by the initial state
+// and polynomial coefficients rounded to multiples of per-component
+// tolerances. Inputs that round to the same key share a solution, so the
+// tolerances trade accuracy for solves saved.
+//
+class SolutionCache {
+ public:
+  enum Mode {
+    kReturnPlan,  // a hit is the solution
+    kWarmStart,   // a hit is the starting point of the solve
+  };
+
+  struct Options {
+    // Number of solutions kept; 0 disables the cache.
+    size_t capacity = 0;
+    Mode mode = kReturnPlan;
+    // Quantization of x, y, psi, v, cte, epsi and of c0..c3.
+    double state_tolerance[6] = {1.0e-3, 1.0e-3, 1.0e-4,
+                                 5.0e-2, 1.0e-3, 1.0e-4};
+    double coeffs_tolerance[4] = {1.0e-3, 1.0e-4, 1.0e-5, 1.0e-7};
+  };
+
+  struct Stats {
+    long lookups = 0;
+    long hits = 0;
+    // Average time of the solves of misses, and the time hits saved
+    // compared to it.
+    double miss_solve_ms = 0.0;
+    double saved_ms = 0.0;
+
+    double HitRate() const { return lookups > 0 ? double(hits) / lookups : 0.0; }
+  };
+
+  SolutionCache() {}
+
+  // Set the options and clear the cache.
+  void Configure(const Options &options);
+  const Options &GetOptions() const { return options_; }
+  bool Enabled() const { return options_.capacity > 0; }
+
+  // Solution cached for `state` and `coeffs`, or null. Counts as a lookup.
+  const Eigen::VectorXd *Find(const Eigen::VectorXd &state,
+                              const Eigen::VectorXd &coeffs);
+  void Insert(const Eigen::VectorXd &state, const Eigen::VectorXd &coeffs,
+              const Eigen::VectorXd &solution);
+  void Clear();
+
+  // Time spent solving after the last Find(), 0 if the hit was returned.
+  void RecordSolve(bool hit, double solve_ms);
+
+  const Stats &GetStats() const { return stats_; }
+
+ private:
+  typedef std::array<int64_t, 10> Key;
+  struct KeyHash {
+    size_t operator()(const Key &key) const;
+  };
+  struct Entry {
+    Key key;
+    Eigen::VectorXd solution;
+  };
+
+  Key MakeKey(const Eigen::VectorXd &state,
+              const Eigen::VectorXd &coeffs) const;
+
+  Options options_;
+  Stats stats_;
+  long num_misses_ = 0;
+
+  // Most recently used first.
+  std::list<Entry> entries_;
+  std::unordered_map<Key, std::list<Entry>::iterator, KeyHash> index_;
+};
+
+#endif  // SOLUTION_CACHE_H
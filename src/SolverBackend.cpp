@@ -0,0 +1,113 @@
+#include "SolverBackend.h"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include "ADMMQPSolver.h"
+#include "CondensedQPSolver.h"
+#include "ILQRSolver.h"
+#include "IpoptBackend.h"
+#include "MPCQP.h"
+#include "MultiStartBackend.h"
+#include "RTISolver.h"
+#include "RiccatiQPSolver.h"
+
+SolverBackend::SolverBackend(const MPCLayout &layout)
+    : lb(Eigen::VectorXd::Constant(layout.n_vars, -1.0e19)),
+      ub(Eigen::VectorXd::Constant(layout.n_vars, 1.0e19)),
+      layout_(layout) {}
+
+bool SolverBackend::Solve(const Eigen::VectorXd &state,
+                          const Eigen::VectorXd &coeffs) {
+  auto start = std::chrono::steady_clock::now();
+  deadline_hit_ = false;
+  bool ok = SolveImpl(state, coeffs);
+  auto end = std::chrono::steady_clock::now();
+
+  stats_.ok = ok;
+  stats_.iterations = LastIterations();
+  stats_.cost = MPCCost(layout_, Solution().data());
+  stats_.solve_ms =
+      std::chrono::duration<double, std::milli>(end - start).count();
+  stats_.deadline_hit = deadline_hit_;
+  ++stats_.num_solves;
+  if (!ok) {
+    ++stats_.num_failures;
+  }
+  if (deadline_hit_) {
+    ++stats_.num_deadline_hits;
+  }
+  if (stats_.iterations > 0) {
+    stats_.total_iterations += stats_.iterations;
+  }
+  stats_.total_solve_ms += stats_.solve_ms;
+  return ok;
+}
+
+const std::vector<std::string> &SolverBackendNames() {
+  static const std::vector<std::string> names = {
+    "ipopt", "ipopt-legacy", "ipopt-analytic",
+#ifdef MPC_IPOPT_THREAD_SAFE
+    "ipopt-multistart",
+#endif
+    "rti", "rti-kkt", "rti-admm", "rti-riccati", "rti-riccati-f32",
+    "rti-multistart", "ilqr", "ilqr-f32", "ilqr-multistart"};
+  return names;
+}
+
+bool SolverBackendSupports(const std::string &name, const MPCLayout &layout) {
+  const std::vector<std::string> &names = SolverBackendNames();
+  if (std::find(names.begin(), names.end(), name) == names.end()) {
+    return false;
+  }
+  return !(layout.IsBlocked() && (name.compare(0, 11, "rti-riccati") == 0 ||
+                                  name.compare(0, 4, "ilqr") == 0));
+}
+
+std::unique_ptr<SolverBackend> MakeSolverBackend(const std::string &name,
+                                                 const MPCLayout &layout) {
+  std::unique_ptr<SolverBackend> backend;
+  if (!SolverBackendSupports(name, layout)) {
+    return backend;
+  }
+  if (name == "ipopt") {
+    backend.reset(new IpoptBackend(layout, true));
+  } else if (name == "ipopt-legacy") {
+    backend.reset(new IpoptBackend(layout, false));
+  } else if (name == "ipopt-analytic") {
+    backend.reset(new IpoptBackend(layout, true, true));
+  } else if (name == "ipopt-multistart" || name == "rti-multistart" ||
+             name == "ilqr-multistart") {
+    if (MultiStartBackend::Pool() != nullptr) {
+      backend.reset(new MultiStartBackend(
+          layout, name.substr(0, name.size() - strlen("-multistart"))));
+    }
+  } else if (name == "rti") {
+    backend.reset(new RTISolver(
+        layout, std::unique_ptr<MPCQPSolver>(new CondensedQPSolver)));
+  } else if (name == "rti-kkt") {
+    backend.reset(new RTISolver(
+        layout, std::unique_ptr<MPCQPSolver>(new DenseKKTSolver), name));
+  } else if (name == "rti-admm") {
+    backend.reset(new RTISolver(
+        layout, std::unique_ptr<MPCQPSolver>(new ADMMQPSolver), name));
+  } else if (name == "rti-riccati") {
+    backend.reset(new RTISolver(
+        layout, std::unique_ptr<MPCQPSolver>(new RiccatiQPSolver), name));
+  } else if (name == "rti-riccati-f32") {
+    backend.reset(new RTISolver(
+        layout, std::unique_ptr<MPCQPSolver>(new RiccatiQPSolverF), name));
+  } else if (name == "ilqr") {
+    backend.reset(new ILQRSolver(layout));
+  } else if (name == "ilqr-f32") {
+    backend.reset(new ILQRSolverF(layout));
+  }
+  return backend;
+}
+
+bool SolverBackendIsThreadSafe(const std::string &name) {
+#ifdef MPC_IPOPT_THREAD_SAFE
+  return true;
+#else
+  return name.compare(0, 5, "ipopt") != 0;
+#endif
+}
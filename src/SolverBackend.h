@@ -0,0 +1,110 @@
+#ifndef SOLVER_BACKEND_H
+#define SOLVER_BACKEND_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "Eigen-3.3/Eigen/Core"
+#include "Deadline.h"
+#include "MPCProblem.h"
+
+// Statistics of a SolverBackend: the last solve and totals over all solves.
+struct SolverStats {
+  bool ok = false;
+  int iterations = -1;  // -1 if the solver does not report them
+  double cost = 0.0;
+  double solve_ms = 0.0;
+  bool deadline_hit = false;
+
+  long num_solves = 0;
+  long num_failures = 0;
+  long num_deadline_hits = 0;
+  long total_iterations = 0;
+  double total_solve_ms = 0.0;
+};
+
+//
+// Solver of the MPC problem for one layout.
+//
+// The caller writes the variable bounds into lb and ub (SetBoundsT, plus
+// any extra pins) and calls Solve() with the initial state, which is
+// constrained to equal `state`, and the polynomial coefficients. Backends
+// warm start from their previous solution unless use_warm_start is unset,
+// and may do work for the next frame in Prepare(). With a deadline set,
+// Solve() returns by then with the best iterate it has, counting a feasible
+// one as success.
+//
+class SolverBackend {
+ public:
+  explicit SolverBackend(const MPCLayout &layout);
+  virtual ~SolverBackend() {}
+
+  virtual const char *Name() const = 0;
+  const MPCLayout &Layout() const { return layout_; }
+
+  // Variable bounds in the order of the layout.
+  Eigen::VectorXd lb, ub;
+
+  bool use_warm_start = true;
+  // Starting point of a solve without warm start, all variables in the
+  // order of the layout; empty for the backend's default.
+  Eigen::VectorXd initial_guess;
+  // Wall-clock deadline of the next Solve().
+  Deadline deadline;
+
+  // Forget the previous solution; the next solve starts cold.
+  virtual void ResetWarmStart() = 0;
+
+  // Work between frames, after the actuation was sent.
+  virtual void Prepare() {}
+
+  // Solve and update the statistics. Returns true on success; Solution()
+  // holds the last iterate either way.
+  bool Solve(const Eigen::VectorXd &state, const Eigen::VectorXd &coeffs);
+
+  // Variables of the last solve, in the order of the layout.
+  virtual const Eigen::VectorXd &Solution() const = 0;
+
+  const SolverStats &Stats() const { return stats_; }
+  void ResetStats() { stats_ = SolverStats(); }
+
+ protected:
+  virtual bool SolveImpl(const Eigen::VectorXd &state,
+                         const Eigen::VectorXd &coeffs) = 0;
+  // Iterations of the last SolveImpl(), -1 if unknown.
+  virtual int LastIterations() const = 0;
+
+  MPCLayout layout_;
+  // Set by SolveImpl() if it stopped early because of the deadline.
+  bool deadline_hit_ = false;
+
+ private:
+  SolverStats stats_;
+};
+
+// Names accepted by MakeSolverBackend().
+const std::vector<std::string> &SolverBackendNames();
+
+// Backend called `name` for `layout`, or null for an unknown name or a
+// layout it does not support (see SolverBackendSupports()). The
+// stage-wise backends "rti-riccati" and "ilqr" need a free actuation per
+// step and are null for layouts with move blocking, as are their "-f32"
+// variants, which do the bulk of their linear algebra in float.
+//
+// The "-multistart" backends run several instances of "rti", "ilqr" or
+// "ipopt" at once (see MultiStartBackend) and are null if no threads could
+// be set up for them. "ipopt-multistart" is only built with
+// MPC_IPOPT_THREAD_SAFE, for an Ipopt that may be called from several
+// threads at once: Ipopt 3.12 with MUMPS is not.
+std::unique_ptr<SolverBackend> MakeSolverBackend(const std::string &name,
+                                                 const MPCLayout &layout);
+
+// Whether `name` is known and supports `layout`, i.e. MakeSolverBackend()
+// builds it unless it runs out of threads.
+bool SolverBackendSupports(const std::string &name, const MPCLayout &layout);
+
+// Whether backends called `name` may solve on several threads at once, each
+// its own problem. Not the Ipopt ones unless MPC_IPOPT_THREAD_SAFE.
+bool SolverBackendIsThreadSafe(const std::string &name);
+
+#endif  // SOLVER_BACKEND_H
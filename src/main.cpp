@@ -1,7 +1,10 @@
 #include <math.h>
 #include <uWS/uWS.h>
 #include <chrono>
+#include <cstdlib>
 #include <iostream>
+#include <iterator>
+#include <sstream>
 #include <string>
 #include <thread>
 #include <vector>
@@ -9,11 +12,16 @@
 #include "Eigen-3.3/Eigen/QR"
 #include "helpers.h"
 #include "json.hpp"
-#include "MPC.h"
+#include "FixedMPC.h"
+#include "FleetMPC.h"
+#include "MPCTable.h"
 
 #define DEBUG_OUTPUT
 #undef DEBUG_OUTPUT
 
+#define FIXED_HORIZON_MPC
+#undef FIXED_HORIZON_MPC // comment to solve with the compile-time horizon FixedMPC<10>
+
 #define LATENCY_HANDLING
 //#undef LATENCY_HANDLING // comment to activate latency and latency handling
 
@@ -29,17 +37,177 @@ double rad2deg(double x) { return x * 180 / pi(); }
 
 const double latency_dt_ms = 100.0; // in milliseconds
 const double latency_dt = latency_dt/1000.0; // in seconds
-const double Lf = 2.67;
+
+// Wall-clock budget of a solve, counted from the arrival of the telemetry.
+// Better a slightly suboptimal plan than a missed control period.
+const double solve_deadline_ms = 50.0; // in milliseconds
+
+// Solutions kept per vehicle with --cache or --cache-warm.
+const size_t cache_capacity = 256;
+
+// Horizons (N, dt) of --adaptive, the default first: up to 3 s ahead.
+const HorizonScheduler::Horizon adaptive_horizons[] = {
+    {10, 0.1}, {7, 0.1}, {15, 0.1}, {20, 0.1}, {15, 0.15}, {20, 0.15}};
 
 
-int main() {
+int main(int argc, char *argv[]) {
   uWS::Hub h;
 
-  // MPC is initialized here!
-  MPC mpc;
+  // MPC is initialized here! Every connection drives a vehicle of its own.
+  FleetMPC fleet;
+  fleet.verbose = true;
+#ifdef FIXED_HORIZON_MPC
+  FixedMPC<10> fixed_mpc;
+#endif
+  // Explicit MPC from mpc_table_gen, solving online only off its grid.
+  MPCTable table;
 
-  h.onMessage([&mpc](uWS::WebSocket<uWS::SERVER> ws, char *data, size_t length,
-                     uWS::OpCode opCode) {
+  // Solver backend, e.g. --solver=rti, and table, e.g. --table=mpc.table
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    if (arg.compare(0, 9, "--solver=") == 0 &&
+        fleet.SetSolver(arg.substr(9))) {
+      continue;
+    }
+    // Solution cache, e.g. --cache=2 to reuse plans with twice the default
+    // quantization tolerances, --cache-warm=2 to warm start from them.
+    if (arg.compare(0, 8, "--cache=") == 0 ||
+        arg.compare(0, 13, "--cache-warm=") == 0) {
+      bool warm = arg[7] == '-';
+      double scale = atof(arg.substr(warm ? 13 : 8).c_str());
+      if (scale > 0.0) {
+        SolutionCache::Options &cache = fleet.cache;
+        cache.capacity = cache_capacity;
+        cache.mode =
+            warm ? SolutionCache::kWarmStart : SolutionCache::kReturnPlan;
+        for (double &tolerance : cache.state_tolerance) {
+          tolerance *= scale;
+        }
+        for (double &tolerance : cache.coeffs_tolerance) {
+          tolerance *= scale;
+        }
+        continue;
+      }
+    }
+    // Move blocking, e.g. --blocks=1,1,2,2,3 for 5 moves over the 9 steps
+    // with actuations.
+    if (arg.compare(0, 9, "--blocks=") == 0) {
+      std::vector<size_t> blocks;
+      std::istringstream list(arg.substr(9));
+      string block;
+      while (std::getline(list, block, ',')) {
+        blocks.push_back(atoi(block.c_str()));
+      }
+      if (fleet.SetMoveBlocks(blocks)) {
+        continue;
+      }
+    }
+    // The horizons of --adaptive have uniform grids of their own.
+    if ((arg.compare(0, 7, "--grid=") == 0 &&
+         !fleet.horizons.horizons.empty()) ||
+        (arg.compare(0, 11, "--adaptive=") == 0 &&
+         !fleet.StepSizes().empty())) {
+      std::cerr << "--grid and --adaptive cannot be combined" << std::endl;
+      return -1;
+    }
+    // Non-uniform time grid, e.g.
+    // --grid=0.05,0.05,0.1,0.15,0.2,0.25,0.3,0.4,0.5 to look 2 s ahead with
+    // the 10 steps of the default 1 s.
+    if (arg.compare(0, 7, "--grid=") == 0) {
+      std::vector<double> dts;
+      std::istringstream list(arg.substr(7));
+      string step;
+      while (std::getline(list, step, ',')) {
+        dts.push_back(atof(step.c_str()));
+      }
+      if (fleet.SetStepSizes(dts)) {
+        continue;
+      }
+    }
+    // Adaptive horizon, e.g. --adaptive=20 to look as far ahead as solves
+    // within 20 ms allow.
+    if (arg.compare(0, 11, "--adaptive=") == 0) {
+      double budget_ms = atof(arg.substr(11).c_str());
+      if (budget_ms > 0.0) {
+        HorizonScheduler::Options &horizons = fleet.horizons;
+        horizons.horizons.assign(std::begin(adaptive_horizons),
+                                 std::end(adaptive_horizons));
+        horizons.budget_ms = budget_ms;
+        continue;
+      }
+    }
+    if (arg.compare(0, 8, "--table=") == 0) {
+      string error;
+      if (!table.Load(arg.substr(8), &error)) {
+        std::cerr << error << std::endl;
+        return -1;
+      }
+      continue;
+    }
+    std::cerr << "Unknown argument " << arg << std::endl;
+    std::cerr << "Usage: " << argv[0]
+              << " [--solver=<name>] [--table=<file>] [--blocks=<n,n,...>]"
+              << " [--grid=<dt,dt,...>] [--adaptive=<budget ms>]"
+              << " [--cache=<scale> | --cache-warm=<scale>], name one of:";
+    for (const string &name : SolverBackendNames()) {
+      std::cerr << " " << name;
+    }
+    std::cerr << std::endl;
+    return -1;
+  }
+  // The table only holds the solutions of the problem it was solved for.
+  if (table.IsLoaded()) {
+    std::vector<MPCLayout> layouts = MPC::Layouts(
+        fleet.MoveBlocks(), fleet.StepSizes(), fleet.horizons);
+    if (layouts.size() != 1 || !table.Matches(layouts[0])) {
+      std::cerr << "The table is for N " << table.Header().N << ", dt "
+                << table.Header().dt << " without move blocking, not for"
+                << " the configured horizon" << std::endl;
+      return -1;
+    }
+#ifdef LATENCY_HANDLING
+    // The table is keyed on the vehicle frame, x = y = psi = 0. The state
+    // predicted after a latency has moved off it, so the table would never
+    // answer.
+    if (latency_dt > 0.0) {
+      std::cerr << "The table needs the state in the vehicle frame, which"
+                << " the latency prediction of " << latency_dt_ms
+                << " ms moves off" << std::endl;
+      return -1;
+    }
+#endif
+  }
+  std::cout << "Solver backend " << fleet.SolverName() << std::endl;
+  if (!fleet.MoveBlocks().empty()) {
+    std::cout << "Move blocks";
+    for (size_t block : fleet.MoveBlocks()) {
+      std::cout << " " << block;
+    }
+    std::cout << std::endl;
+  }
+  if (!fleet.StepSizes().empty()) {
+    MPCLayout grid(fleet.StepSizes());
+    std::cout << "Time grid N " << grid.N << " over " << grid.Duration()
+              << " s" << std::endl;
+  }
+  if (fleet.horizons.horizons.size() > 1) {
+    std::cout << "Adaptive horizon within " << fleet.horizons.budget_ms
+              << " ms" << std::endl;
+  }
+  if (table.IsLoaded()) {
+    std::cout << "Table of " << table.Header().NumPoints() << " points"
+              << std::endl;
+  }
+
+  h.onMessage([&fleet,
+#ifdef FIXED_HORIZON_MPC
+               &fixed_mpc,
+#endif
+               &table](uWS::WebSocket<uWS::SERVER> ws, char *data,
+                       size_t length, uWS::OpCode opCode) {
+    Deadline::Clock::time_point arrival = Deadline::Clock::now();
+    // Vehicle of this connection, stored as id + 1.
+    size_t vehicle = reinterpret_cast<size_t>(ws.getUserData()) - 1;
     // "42" at the start of the message means there's a websocket message event.
     // The 4 signifies a websocket message
     // The 2 signifies a websocket event
@@ -112,13 +280,19 @@ int main() {
           double throttle_value = j[1]["throttle"];    // grab from json, inspired by video walkthrough
 
 #ifdef LATENCY_HANDLING
-          // Add latency of 100ms
-          px = v * cos(psi) * latency_dt;
-          py = v * sin(psi) * latency_dt;
-          psi = v * psi / Lf * latency_dt;
-          v = v + throttle_value * latency_dt;
-          cte = cte + v * sin(epsi) * latency_dt;
-          epsi = epsi + v * psi / Lf * latency_dt;
+          // Add latency of 100ms: the state after the latency, predicted by
+          // the model from the actuations applied meanwhile (the steering
+          // as sent below, normalized and with the opposite sign).
+          const double latency_state[6] = {px, py, psi, v, cte, epsi};
+          double predicted[6];
+          ModelStepT(latency_state, -steer_value * deg2rad(25) * Lf,
+                     throttle_value, coeffs.data(), latency_dt, predicted);
+          px = predicted[kX];
+          py = predicted[kY];
+          psi = predicted[kPsi];
+          v = predicted[kV];
+          cte = predicted[kCte];
+          epsi = predicted[kEpsi];
 #endif
 
           Eigen::VectorXd state(6);
@@ -127,7 +301,21 @@ int main() {
 #ifdef DEBUG_OUTPUT
           //std::cout<<"calling mpc.Solve"<<std::endl;
 #endif
-          auto vars = mpc.Solve(state, coeffs);
+          // Whether the fleet solved, and has its next frame to prepare.
+          bool solved_online = false;
+#ifdef FIXED_HORIZON_MPC
+          const FixedMPC<10>::Result &fixed_vars = fixed_mpc.Solve(state, coeffs);
+          vector<double> vars(fixed_vars.begin(), fixed_vars.end());
+#else
+          // Without a trajectory from the table only the actuations are
+          // sent, so no green line is drawn.
+          vector<double> vars(2);
+          if (!table.Lookup(state, coeffs, &vars[0], &vars[1])) {
+            solved_online = true;
+            fleet.deadline = Deadline::After(arrival, solve_deadline_ms);
+            vars = fleet.Solve({{vehicle, state, coeffs}})[0];
+          }
+#endif
 #ifdef DEBUG_OUTPUT
           //std::cout<<"mpc.Solve called"<<std::endl;
 #endif
@@ -240,6 +428,12 @@ int main() {
 #ifdef DEBUG_OUTPUT
           std::cout<<"json msg sent"<<std::endl;
 #endif
+          // Off the critical path: linearize for the next telemetry, unless
+          // the table answered and the backend has nothing new to start
+          // from.
+          if (solved_online) {
+            fleet.Prepare({vehicle});
+          }
         }  // end "telemetry" if
       } else {
         // Manual driving
@@ -249,12 +443,16 @@ int main() {
     }  // end websocket if
   }); // end h.onMessage
 
-  h.onConnection([&h](uWS::WebSocket<uWS::SERVER> ws, uWS::HttpRequest req) {
-    std::cout << "Connected!!!" << std::endl;
+  h.onConnection([&h, &fleet](uWS::WebSocket<uWS::SERVER> ws,
+                              uWS::HttpRequest req) {
+    size_t vehicle = fleet.AddVehicle();
+    ws.setUserData(reinterpret_cast<void *>(vehicle + 1));
+    std::cout << "Connected!!! Vehicle " << vehicle << std::endl;
   });
 
-  h.onDisconnection([&h](uWS::WebSocket<uWS::SERVER> ws, int code,
-                         char *message, size_t length) {
+  h.onDisconnection([&h, &fleet](uWS::WebSocket<uWS::SERVER> ws, int code,
+                                 char *message, size_t length) {
+    fleet.RemoveVehicle(reinterpret_cast<size_t>(ws.getUserData()) - 1);
     ws.close();
     std::cout << "Disconnected" << std::endl;
   });
@@ -0,0 +1,692 @@
+//
+// Closed-loop benchmark of solver backends: drives the kinematic model
+// around a track with every backend in turn, from the same start, and
+// reports the tracking error and the solve times, e.g. of the double and
+// float variants of a backend.
+//
+//   mpc_bench <track csv> [--solvers=<name,name,...>] [--frames=<n>]
+//   mpc_bench --check-derivatives
+//   mpc_bench --bench-jacobians
+//   mpc_bench --check-fleet
+//   mpc_bench --bench-fleet
+//
+// The track is a closed loop of waypoints, "x,y" per line after a header
+// line, like lake_track_waypoints.csv. Every frame the MPC gets the
+// polynomial through the 6 waypoints around the vehicle, as from the
+// simulator, without latency.
+//
+// --check-derivatives compares MPCAnalyticDerivatives with the CppAD tape
+// of FG_evalT at random points, for layouts with and without move blocking
+// and a non-uniform grid, and reports the largest differences and the
+// evaluation times of both, and compares ModelJacobian() with the
+// derivatives of ModelStepT() in Eigen::AutoDiffScalar and StageDual. It
+// fails if a difference is above 1e-9, relative to the larger of 1 and the
+// magnitude of the value.
+//
+// --bench-jacobians times the model Jacobians of one step, as needed to
+// linearize the SQP and iLQR backends: ModelJacobian() with ModelStep(),
+// ModelJacobianDual(), a CppAD tape of one step, and the sparse Jacobian of
+// the constraints on the tape of the whole NLP, per step.
+//
+// --check-fleet compares the Rollout() and Cost() of FleetEvaluator with
+// RolloutT() and MPCCost() of every vehicle, and Gradient() with central
+// differences of MPCCost(), at random trajectories. It fails if a
+// difference is above 1e-9, relative as above, or one of the gradient is
+// above 1e-6 of its largest entry.
+//
+// --bench-fleet times FleetEvaluator on many vehicles at once against
+// RolloutT() and MPCCost() one vehicle at a time, and its gradient against
+// that of a FleetEvaluator of one vehicle, which Eigen cannot vectorize.
+//
+#include <math.h>
+#include <algorithm>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "Eigen-3.3/Eigen/Core"
+#include "Eigen-3.3/Eigen/QR"
+#include "helpers.h"
+#include "FG_eval.h"
+#include "FleetEvaluator.h"
+#include "MPC.h"
+#include "MPCAnalyticDerivatives.h"
+#include "MPCAutoDiff.h"
+#include "MPCTape.h"
+
+using std::string;
+using std::vector;
+
+// Control period, the step of the simulated vehicle.
+const double frame_dt = 0.1;
+
+struct Track {
+  vector<double> x, y;
+
+  size_t Size() const { return x.size(); }
+
+  // Index of the waypoint closest to (px, py).
+  size_t Closest(double px, double py) const {
+    size_t closest = 0;
+    double best = INFINITY;
+    for (size_t i = 0; i < Size(); ++i) {
+      double d = (x[i] - px) * (x[i] - px) + (y[i] - py) * (y[i] - py);
+      if (d < best) {
+        best = d;
+        closest = i;
+      }
+    }
+    return closest;
+  }
+
+  // Distance of (px, py) from the polyline through the waypoints.
+  double Distance(double px, double py) const {
+    double best = INFINITY;
+    for (size_t i = 0; i < Size(); ++i) {
+      size_t j = (i + 1) % Size();
+      double dx = x[j] - x[i], dy = y[j] - y[i];
+      double s = ((px - x[i]) * dx + (py - y[i]) * dy) / (dx * dx + dy * dy);
+      s = std::min(std::max(s, 0.0), 1.0);
+      double ex = x[i] + s * dx - px, ey = y[i] + s * dy - py;
+      best = std::min(best, sqrt(ex * ex + ey * ey));
+    }
+    return best;
+  }
+};
+
+bool LoadTrack(const string &path, Track *track) {
+  std::ifstream in(path.c_str());
+  string line;
+  std::getline(in, line);  // header
+  while (std::getline(in, line)) {
+    std::istringstream fields(line);
+    double x, y;
+    char comma;
+    if (fields >> x >> comma >> y) {
+      track->x.push_back(x);
+      track->y.push_back(y);
+    }
+  }
+  return track->Size() >= 6;
+}
+
+struct Result {
+  double rms_error = 0.0;
+  double max_error = 0.0;
+  double mean_speed = 0.0;
+  // Solve times.
+  double mean_ms = 0.0;
+  double p50_ms = 0.0;
+  double p99_ms = 0.0;
+  double max_ms = 0.0;
+  double mean_iterations = 0.0;
+  long num_failures = 0;
+};
+
+Result Drive(const Track &track, const string &solver, int num_frames) {
+  MPC mpc;
+  mpc.verbose = false;
+  mpc.SetSolver(solver);
+
+  // Start on the first waypoint, heading to the second.
+  double px = track.x[0], py = track.y[0], v = 0.0;
+  double psi = atan2(track.y[1] - track.y[0], track.x[1] - track.x[0]);
+
+  Result result;
+  vector<double> solve_ms;
+  double sum_squares = 0.0;
+  for (int frame = 0; frame < num_frames; ++frame) {
+    // The waypoints from the one before the closest, in vehicle
+    // coordinates.
+    size_t first = (track.Closest(px, py) + track.Size() - 1) % track.Size();
+    Eigen::VectorXd ptsx(6), ptsy(6);
+    for (size_t i = 0; i < 6; ++i) {
+      size_t k = (first + i) % track.Size();
+      double shift_x = track.x[k] - px;
+      double shift_y = track.y[k] - py;
+      ptsx[i] = shift_x * cos(-psi) - shift_y * sin(-psi);
+      ptsy[i] = shift_x * sin(-psi) + shift_y * cos(-psi);
+    }
+    Eigen::VectorXd coeffs = polyfit(ptsx, ptsy, 3);
+    Eigen::VectorXd state(6);
+    state << 0.0, 0.0, 0.0, v, polyeval(coeffs, 0.0), -atan(coeffs[1]);
+
+    vector<double> vars = mpc.Solve(state, coeffs);
+    const SolverStats &stats = mpc.Stats();
+    solve_ms.push_back(stats.solve_ms);
+    result.mean_iterations += std::max(stats.iterations, 0);
+    result.num_failures += !stats.ok;
+
+    // The vehicle follows the model exactly.
+    double delta = vars[0], a = vars[1];
+    px += v * cos(psi) * frame_dt;
+    py += v * sin(psi) * frame_dt;
+    psi += v / Lf * delta * frame_dt;
+    v += a * frame_dt;
+    mpc.Prepare();
+
+    double error = track.Distance(px, py);
+    sum_squares += error * error;
+    result.max_error = std::max(result.max_error, error);
+    result.mean_speed += v;
+  }
+
+  result.rms_error = sqrt(sum_squares / num_frames);
+  result.mean_speed /= num_frames;
+  result.mean_iterations /= num_frames;
+  for (double ms : solve_ms) {
+    result.mean_ms += ms / num_frames;
+  }
+  std::sort(solve_ms.begin(), solve_ms.end());
+  result.p50_ms = solve_ms[solve_ms.size() / 2];
+  result.p99_ms = solve_ms[std::min(solve_ms.size() - 1,
+                                    solve_ms.size() * 99 / 100)];
+  result.max_ms = solve_ms.back();
+  return result;
+}
+
+// Largest difference of `a` and `b`, relative to the larger of 1 and the
+// magnitude of the entry of `b`.
+double MaxDifference(const vector<double> &a, const vector<double> &b) {
+  double max_difference = 0.0;
+  for (size_t i = 0; i < a.size(); ++i) {
+    max_difference = std::max(max_difference, fabs(a[i] - b[i]) /
+                                                  std::max(1.0, fabs(b[i])));
+  }
+  return max_difference;
+}
+
+// Uniformly distributed in [lo, hi], from rand().
+double Uniform(double lo, double hi) {
+  return lo + (hi - lo) * rand() / RAND_MAX;
+}
+
+// Microseconds per call of `eval`.
+template <class Eval>
+double TimeUs(Eval eval) {
+  const int repeats = 1000;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < repeats; ++i) {
+    eval();
+  }
+  return std::chrono::duration<double, std::micro>(
+             std::chrono::steady_clock::now() - start)
+             .count() /
+         repeats;
+}
+
+// Compare the analytic derivatives of `layout` with the tape. Returns
+// false on a mismatch.
+bool CheckDerivatives(const string &name, const MPCLayout &layout) {
+  MPCTape tape;
+  FG_evalT<MPCLayout> fg_eval(layout);
+  SparsityPattern jac, hes;
+  MPCSparsityT(layout, jac, hes);
+  tape.Record(fg_eval, layout.n_vars, layout.n_constraints, 4, &jac, &hes);
+  MPCAnalyticDerivatives analytic(layout);
+  if (tape.JacRows() != analytic.JacRows() ||
+      tape.JacCols() != analytic.JacCols() ||
+      tape.HesRows() != analytic.HesRows() ||
+      tape.HesCols() != analytic.HesCols()) {
+    std::cout << name << ": the sparsity patterns differ" << std::endl;
+    return false;
+  }
+
+  const size_t n = layout.n_vars, m = layout.n_constraints;
+  vector<double> x(n), lambda(m), coeffs(4);
+  vector<double> tape_g(m), analytic_g(m);
+  vector<double> tape_grad(n), analytic_grad(n);
+  vector<double> tape_jac(tape.JacRows().size());
+  vector<double> analytic_jac(tape_jac.size());
+  vector<double> tape_hes(tape.HesRows().size());
+  vector<double> analytic_hes(tape_hes.size());
+  double f = 0.0, g = 0.0, grad = 0.0, jac_g = 0.0, hes_lag = 0.0;
+  srand(1);
+  for (int point = 0; point < 100; ++point) {
+    for (size_t i = 0; i < n; ++i) {
+      x[i] = Uniform(-1.0, 1.0);
+    }
+    for (size_t t = 0; t < layout.N; ++t) {
+      x[layout.x_start + t] = Uniform(-5.0, 50.0);
+      x[layout.v_start + t] = Uniform(0.0, 50.0);
+    }
+    for (size_t i = 0; i < m; ++i) {
+      lambda[i] = Uniform(-100.0, 100.0);
+    }
+    coeffs = {Uniform(-2.0, 2.0), Uniform(-0.5, 0.5), Uniform(-0.02, 0.02),
+              Uniform(-0.001, 0.001)};
+    const double obj_factor = Uniform(0.0, 1.0);
+    tape.SetParameters(coeffs.data());
+    analytic.SetParameters(coeffs.data());
+
+    f = std::max(f, MaxDifference({analytic.EvalF(x.data())},
+                                  {tape.EvalF(x.data())}));
+    tape.EvalG(x.data(), tape_g.data());
+    analytic.EvalG(x.data(), analytic_g.data());
+    g = std::max(g, MaxDifference(analytic_g, tape_g));
+    tape.EvalGradF(x.data(), tape_grad.data());
+    analytic.EvalGradF(x.data(), analytic_grad.data());
+    grad = std::max(grad, MaxDifference(analytic_grad, tape_grad));
+    tape.EvalJacG(x.data(), tape_jac.data());
+    analytic.EvalJacG(x.data(), analytic_jac.data());
+    jac_g = std::max(jac_g, MaxDifference(analytic_jac, tape_jac));
+    tape.EvalHesLag(x.data(), obj_factor, lambda.data(), tape_hes.data());
+    analytic.EvalHesLag(x.data(), obj_factor, lambda.data(),
+                        analytic_hes.data());
+    hes_lag = std::max(hes_lag, MaxDifference(analytic_hes, tape_hes));
+  }
+
+  // Time of the derivatives of one Ipopt iteration.
+  auto iteration = [&](MPCDerivatives &derivatives) {
+    derivatives.EvalGradF(x.data(), tape_grad.data());
+    derivatives.EvalJacG(x.data(), tape_jac.data());
+    derivatives.EvalHesLag(x.data(), 1.0, lambda.data(), tape_hes.data());
+  };
+  const double tape_us = TimeUs([&]() { iteration(tape); });
+  const double analytic_us = TimeUs([&]() { iteration(analytic); });
+
+  char line[200];
+  snprintf(line, sizeof(line),
+           "%-24s f %8.1e  g %8.1e  grad %8.1e  jac %8.1e  hes %8.1e"
+           "  tape %8.2f us  analytic %8.2f us",
+           name.c_str(), f, g, grad, jac_g, hes_lag, tape_us, analytic_us);
+  std::cout << line << std::endl;
+  const double tolerance = 1.0e-9;
+  return f <= tolerance && g <= tolerance && grad <= tolerance &&
+         jac_g <= tolerance && hes_lag <= tolerance;
+}
+
+// Compare ModelJacobian() with the derivatives of ModelStepT() by
+// AutoDiffScalar and with ModelJacobianDual(). Returns false on a mismatch.
+bool CheckModelJacobian() {
+  typedef Eigen::AutoDiffScalar<Eigen::VectorXd> ADScalar;
+  srand(1);
+  double max_difference = 0.0;
+  for (int point = 0; point < 100; ++point) {
+    Vector6d s0;
+    s0 << Uniform(-5.0, 50.0), Uniform(-1.0, 1.0), Uniform(-1.0, 1.0),
+        Uniform(0.0, 50.0), Uniform(-1.0, 1.0), Uniform(-1.0, 1.0);
+    const double delta0 = Uniform(-max_delta, max_delta);
+    const double a0 = Uniform(-max_a, max_a);
+    const double coeffs[] = {Uniform(-2.0, 2.0), Uniform(-0.5, 0.5),
+                             Uniform(-0.02, 0.02), Uniform(-0.001, 0.001)};
+    const double dt = Uniform(0.05, 0.5);
+    Matrix6d A;
+    Matrix62d B;
+    ModelJacobian(s0, delta0, a0, coeffs, dt, A, B);
+
+    ADScalar ad_s0[6], ad_s1[6];
+    for (int i = 0; i < 6; ++i) {
+      ad_s0[i] = ADScalar(s0[i], 8, i);
+    }
+    ModelStepT(ad_s0, ADScalar(delta0, 8, 6), ADScalar(a0, 8, 7), coeffs, dt,
+               ad_s1);
+    Matrix6d A_dual;
+    Matrix62d B_dual;
+    Vector6d s1_dual;
+    ModelJacobianDual(s0, delta0, a0, coeffs, dt, A_dual, B_dual, &s1_dual);
+    const Vector6d s1 = ModelStep(s0, delta0, a0, coeffs, dt);
+    for (int i = 0; i < 6; ++i) {
+      vector<double> jacobian(9), derivatives(9), dual(9);
+      for (int j = 0; j < 8; ++j) {
+        jacobian[j] = j < 6 ? A(i, j) : B(i, j - 6);
+        derivatives[j] = ad_s1[i].derivatives()[j];
+        dual[j] = j < 6 ? A_dual(i, j) : B_dual(i, j - 6);
+      }
+      jacobian[8] = derivatives[8] = s1[i];
+      dual[8] = s1_dual[i];
+      max_difference =
+          std::max(max_difference, MaxDifference(jacobian, derivatives));
+      max_difference = std::max(max_difference, MaxDifference(jacobian, dual));
+    }
+  }
+  std::cout << "ModelJacobian vs AutoDiffScalar " << max_difference
+            << std::endl;
+  return max_difference <= 1.0e-9;
+}
+
+// Nanoseconds per step of the model Jacobians of the steps of `layout`,
+// by every method.
+void BenchJacobians(const MPCLayout &layout) {
+  typedef CppAD::AD<double> ADd;
+  const size_t N = layout.N;
+  srand(1);
+  vector<double> x(layout.n_vars);
+  for (size_t i = 0; i < x.size(); ++i) {
+    x[i] = Uniform(-0.2, 0.2);
+  }
+  for (size_t t = 0; t < N; ++t) {
+    x[layout.x_start + t] = Uniform(0.0, 20.0);
+    x[layout.v_start + t] = Uniform(10.0, 30.0);
+  }
+  const double coeffs[] = {0.5, -0.1, 0.01, -0.0005};
+  auto actuation = [&](size_t t) {
+    return Eigen::Vector2d(x[layout.delta_start + layout.Move(t)],
+                           x[layout.a_start + layout.Move(t)]);
+  };
+
+  Matrix6d A;
+  Matrix62d B;
+  Vector6d s1;
+  // Results are added up here so that the timed calls are not optimized
+  // away.
+  volatile double sink = 0.0;
+  auto hand = [&]() {
+    for (size_t t = 0; t + 1 < N; ++t) {
+      Vector6d s = StateAt(layout, x.data(), t);
+      Eigen::Vector2d u = actuation(t);
+      ModelJacobian(s, u[0], u[1], coeffs, layout.Dt(t), A, B);
+      s1 = ModelStep(s, u[0], u[1], coeffs, layout.Dt(t));
+      sink += A(0, 2) + B(3, 1) + s1[0];
+    }
+  };
+  auto dual = [&]() {
+    for (size_t t = 0; t + 1 < N; ++t) {
+      Vector6d s = StateAt(layout, x.data(), t);
+      Eigen::Vector2d u = actuation(t);
+      ModelJacobianDual(s, u[0], u[1], coeffs, layout.Dt(t), A, B, &s1);
+      sink += A(0, 2) + B(3, 1) + s1[0];
+    }
+  };
+
+  // One step on a tape of its own, with the coefficients as independent
+  // variables as well, and its dense Jacobian by forward sweeps.
+  CPPAD_TESTVECTOR(ADd) step_in(12), step_out(6);
+  for (size_t i = 0; i < 12; ++i) {
+    step_in[i] = 0.0;
+  }
+  CppAD::Independent(step_in);
+  ModelStepT(&step_in[0], step_in[6], step_in[7], &step_in[8], layout.Dt(0),
+             &step_out[0]);
+  CppAD::ADFun<double> step_tape(step_in, step_out);
+  step_tape.optimize();
+  vector<double> step_x(12), step_jac(72);
+  auto step = [&]() {
+    for (size_t t = 0; t + 1 < N; ++t) {
+      Vector6d s = StateAt(layout, x.data(), t);
+      Eigen::Vector2d u = actuation(t);
+      for (size_t i = 0; i < 6; ++i) {
+        step_x[i] = s[i];
+      }
+      step_x[6] = u[0];
+      step_x[7] = u[1];
+      std::copy(coeffs, coeffs + 4, step_x.begin() + 8);
+      step_jac = step_tape.Jacobian(step_x);
+      sink += step_jac[2];
+    }
+  };
+
+  MPCTape nlp_tape;
+  FG_evalT<MPCLayout> fg_eval(layout);
+  SparsityPattern jac, hes;
+  MPCSparsityT(layout, jac, hes);
+  nlp_tape.Record(fg_eval, layout.n_vars, layout.n_constraints, 4, &jac,
+                  &hes);
+  nlp_tape.SetParameters(coeffs);
+  vector<double> nlp_jac(nlp_tape.JacRows().size());
+  auto nlp = [&]() {
+    nlp_tape.EvalJacG(x.data(), nlp_jac.data());
+    sink += nlp_jac[0];
+  };
+
+  const double steps = N - 1;
+  char line[200];
+  snprintf(line, sizeof(line),
+           "N %2zu  ns per step: hand %7.1f  dual %7.1f  step tape %7.1f"
+           "  NLP tape %7.1f",
+           N, 1.0e3 * TimeUs(hand) / steps, 1.0e3 * TimeUs(dual) / steps,
+           1.0e3 * TimeUs(step) / steps, 1.0e3 * TimeUs(nlp) / steps);
+  std::cout << line << std::endl;
+}
+
+// Random variables of `num_vehicles` vehicles of `layout`, one vector each:
+// initial states, actuations within their bounds and the states of
+// RolloutT(), and the coefficients of a gently curved reference line.
+void RandomFleet(const MPCLayout &layout, size_t num_vehicles,
+                 vector<vector<double>> *vars, vector<vector<double>> *coeffs) {
+  vars->assign(num_vehicles, vector<double>(layout.n_vars, 0.0));
+  coeffs->resize(num_vehicles);
+  for (size_t i = 0; i < num_vehicles; ++i) {
+    vector<double> &x = (*vars)[i];
+    x[layout.x_start] = Uniform(-1.0, 1.0);
+    x[layout.y_start] = Uniform(-1.0, 1.0);
+    x[layout.psi_start] = Uniform(-0.2, 0.2);
+    x[layout.v_start] = Uniform(0.0, 50.0);
+    x[layout.cte_start] = Uniform(-2.0, 2.0);
+    x[layout.epsi_start] = Uniform(-0.2, 0.2);
+    for (size_t t = 0; t + 1 < layout.N; ++t) {
+      x[layout.delta_start + t] = Uniform(-0.4, 0.4);
+      x[layout.a_start + t] = Uniform(-1.0, 1.0);
+    }
+    (*coeffs)[i] = {Uniform(-2.0, 2.0), Uniform(-0.5, 0.5),
+                    Uniform(-0.02, 0.02), Uniform(-0.001, 0.001)};
+    RolloutT(layout, (*coeffs)[i].data(), x.data());
+  }
+}
+
+// Compare FleetEvaluator with RolloutT() and MPCCost() of every vehicle,
+// and its gradient with central differences of MPCCost(). Returns false on
+// a mismatch.
+bool CheckFleet(const string &name, const MPCLayout &layout,
+                size_t num_vehicles) {
+  vector<vector<double>> vars, coeffs;
+  srand(1);
+  RandomFleet(layout, num_vehicles, &vars, &coeffs);
+  FleetEvaluator fleet(layout, num_vehicles);
+  for (size_t i = 0; i < num_vehicles; ++i) {
+    // Only step 0 and the actuations are used, the rest has to follow.
+    vector<double> start = vars[i];
+    std::fill(start.begin(), start.begin() + layout.delta_start, 0.0);
+    for (size_t k = 0; k < 6; ++k) {
+      start[layout.StateStart(k)] = vars[i][layout.StateStart(k)];
+    }
+    fleet.SetVehicle(i, start.data(), coeffs[i].data());
+  }
+  fleet.Rollout();
+  const Eigen::ArrayXd cost = fleet.Cost();
+  fleet.Gradient();
+
+  double rollout = 0.0, cost_difference = 0.0, gradient = 0.0;
+  vector<double> fleet_vars(layout.n_vars);
+  for (size_t i = 0; i < num_vehicles; ++i) {
+    fleet.GetVehicle(i, fleet_vars.data());
+    rollout = std::max(rollout, MaxDifference(fleet_vars, vars[i]));
+    cost_difference =
+        std::max(cost_difference,
+                 MaxDifference({cost[i]}, {MPCCost(layout, vars[i].data())}));
+
+    // Central differences of the cost of the rolled out trajectory. Their
+    // rounding error is about the same for every entry, so the differences
+    // are relative to the largest entry of the gradient.
+    vector<double> x = vars[i];
+    auto cost_at = [&](size_t j, double h) {
+      const double saved = x[j];
+      x[j] += h;
+      RolloutT(layout, coeffs[i].data(), x.data());
+      const double c = MPCCost(layout, x.data());
+      x[j] = saved;
+      return c;
+    };
+    const double h = 1.0e-5;
+    double scale = 1.0, difference = 0.0;
+    for (size_t t = 0; t + 1 < layout.N; ++t) {
+      for (size_t j : {layout.delta_start + t, layout.a_start + t}) {
+        const double d = (cost_at(j, h) - cost_at(j, -h)) / (2.0 * h);
+        const double g = j < layout.a_start ? fleet.grad_delta(i, t)
+                                            : fleet.grad_a(i, t);
+        scale = std::max(scale, fabs(d));
+        difference = std::max(difference, fabs(g - d));
+      }
+    }
+    gradient = std::max(gradient, difference / scale);
+  }
+
+  char line[200];
+  snprintf(line, sizeof(line),
+           "%-24s rollout %8.1e  cost %8.1e  gradient %8.1e", name.c_str(),
+           rollout, cost_difference, gradient);
+  std::cout << line << std::endl;
+  // The central differences are only good to about 1e-8: a smaller step
+  // loses more to the rounding of the cost, a larger one to the curvature
+  // of the long steps of the grid.
+  return rollout <= 1.0e-9 && cost_difference <= 1.0e-9 &&
+         gradient <= 1.0e-6;
+}
+
+// Time FleetEvaluator on `num_vehicles` vehicles at once, against
+// RolloutT() and MPCCost() one vehicle after the other and against a
+// FleetEvaluator of a single vehicle, which Eigen cannot vectorize.
+void BenchFleet(const MPCLayout &layout, size_t num_vehicles) {
+  vector<vector<double>> vars, coeffs;
+  srand(1);
+  RandomFleet(layout, num_vehicles, &vars, &coeffs);
+  FleetEvaluator fleet(layout, num_vehicles);
+  FleetEvaluator single(layout, 1);
+  for (size_t i = 0; i < num_vehicles; ++i) {
+    fleet.SetVehicle(i, vars[i].data(), coeffs[i].data());
+  }
+
+  // Results are added up here so that the timed calls are not optimized
+  // away.
+  volatile double sink = 0.0;
+  auto scalar = [&]() {
+    for (size_t i = 0; i < num_vehicles; ++i) {
+      RolloutT(layout, coeffs[i].data(), vars[i].data());
+      sink += MPCCost(layout, vars[i].data());
+    }
+  };
+  auto fleet_cost = [&]() {
+    fleet.Rollout();
+    sink += fleet.Cost()[0];
+  };
+  auto single_gradient = [&]() {
+    for (size_t i = 0; i < num_vehicles; ++i) {
+      single.SetVehicle(0, vars[i].data(), coeffs[i].data());
+      single.Rollout();
+      sink += single.Cost()[0];
+      single.Gradient();
+      sink += single.grad_delta(0, 0);
+    }
+  };
+  auto fleet_gradient = [&]() {
+    fleet.Rollout();
+    sink += fleet.Cost()[0];
+    fleet.Gradient();
+    sink += fleet.grad_delta(0, 0);
+  };
+
+  const double vehicles = num_vehicles;
+  char line[200];
+  snprintf(line, sizeof(line),
+           "N %2zu  %4zu vehicles  ns per vehicle: rollout and cost scalar"
+           " %7.1f  fleet %7.1f;  with gradient single %7.1f  fleet %7.1f",
+           layout.N, num_vehicles, 1.0e3 * TimeUs(scalar) / vehicles,
+           1.0e3 * TimeUs(fleet_cost) / vehicles,
+           1.0e3 * TimeUs(single_gradient) / vehicles,
+           1.0e3 * TimeUs(fleet_gradient) / vehicles);
+  std::cout << line << std::endl;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc == 2 && string(argv[1]) == "--bench-jacobians") {
+    BenchJacobians(MPCLayout(10, 0.1));
+    BenchJacobians(MPCLayout(25, 0.05));
+    return 0;
+  }
+  if (argc == 2 && string(argv[1]) == "--check-fleet") {
+    bool ok = CheckFleet("N 10 vehicles 7", MPCLayout(10, 0.1), 7);
+    ok = CheckFleet("N 25 vehicles 16", MPCLayout(25, 0.05), 16) && ok;
+    ok = CheckFleet("grid 0.05..0.5 vehicles 5",
+                    MPCLayout({0.05, 0.05, 0.1, 0.15, 0.2, 0.25, 0.3, 0.4,
+                               0.5}),
+                    5) &&
+         ok;
+    std::cout << (ok ? "Fleet matches" : "Fleet differs") << std::endl;
+    return ok ? 0 : 1;
+  }
+  if (argc == 2 && string(argv[1]) == "--bench-fleet") {
+    BenchFleet(MPCLayout(10, 0.1), 64);
+    BenchFleet(MPCLayout(25, 0.05), 64);
+    BenchFleet(MPCLayout(10, 0.1), 1024);
+    return 0;
+  }
+  if (argc == 2 && string(argv[1]) == "--check-derivatives") {
+    bool ok = CheckModelJacobian();
+    ok = CheckDerivatives("N 10", MPCLayout(10, 0.1)) && ok;
+    ok = CheckDerivatives("N 25", MPCLayout(25, 0.05)) && ok;
+    ok = CheckDerivatives("N 20 blocks 1,2,3,4",
+                          MPCLayout(20, 0.1, {1, 2, 3, 4})) &&
+         ok;
+    ok = CheckDerivatives("grid 0.05..0.5 blocks 2",
+                          MPCLayout({0.05, 0.05, 0.1, 0.15, 0.2, 0.25, 0.3,
+                                     0.4, 0.5},
+                                    {2})) &&
+         ok;
+    std::cout << (ok ? "Derivatives match" : "Derivatives differ")
+              << std::endl;
+    return ok ? 0 : 1;
+  }
+
+  string path;
+  vector<string> solvers = {"rti-riccati", "rti-riccati-f32", "ilqr",
+                            "ilqr-f32"};
+  int num_frames = 2000;
+  bool usage = false;
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    if (arg.compare(0, 10, "--solvers=") == 0) {
+      solvers.clear();
+      std::istringstream list(arg.substr(10));
+      string name;
+      while (std::getline(list, name, ',')) {
+        const vector<string> &names = SolverBackendNames();
+        if (std::find(names.begin(), names.end(), name) == names.end()) {
+          usage = true;
+        }
+        solvers.push_back(name);
+      }
+    } else if (arg.compare(0, 9, "--frames=") == 0) {
+      num_frames = atoi(arg.substr(9).c_str());
+      usage = usage || num_frames <= 0;
+    } else if (path.empty() && arg.compare(0, 2, "--") != 0) {
+      path = arg;
+    } else {
+      usage = true;
+    }
+  }
+  if (path.empty() || usage) {
+    std::cerr << "Usage: " << argv[0]
+              << " <track csv> [--solvers=<name,name,...>] [--frames=<n>]"
+              << " | --check-derivatives | --bench-jacobians | --check-fleet"
+              << " | --bench-fleet,"
+              << " names of:";
+    for (const string &name : SolverBackendNames()) {
+      std::cerr << " " << name;
+    }
+    std::cerr << std::endl;
+    return -1;
+  }
+  Track track;
+  if (!LoadTrack(path, &track)) {
+    std::cerr << "Failed to read a track from " << path << std::endl;
+    return -1;
+  }
+
+  std::cout << num_frames << " frames of " << frame_dt << " s on a track of "
+            << track.Size() << " waypoints" << std::endl;
+  std::cout << "solver            rms m  max m  speed  iter  fail"
+            << "  mean ms   p50 ms   p99 ms   max ms" << std::endl;
+  for (const string &solver : solvers) {
+    Result r = Drive(track, solver, num_frames);
+    char line[160];
+    snprintf(line, sizeof(line),
+             "%-16s %6.3f %6.3f %6.1f %5.1f %5ld %8.4f %8.4f %8.4f %8.4f",
+             solver.c_str(), r.rms_error, r.max_error, r.mean_speed,
+             r.mean_iterations, r.num_failures, r.mean_ms, r.p50_ms,
+             r.p99_ms, r.max_ms);
+    std::cout << line << std::endl;
+  }
+  return 0;
+}
@@ -0,0 +1,125 @@
+//
+// Offline generator of the explicit MPC table of MPCTable.h: solves the MPC
+// problem on every grid point and writes the first actuations.
+//
+//   mpc_table_gen <table file> [--solver=<name>]
+//
+// The grid points are solved concurrently, one vehicle of a FleetMPC each,
+// by default with "ilqr": it is thread-safe and converges from scratch.
+// Ipopt 3.12 with MUMPS is not thread-safe and only solves one point at a
+// time (see FleetMPC).
+//
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "Eigen-3.3/Eigen/Core"
+#include "FleetMPC.h"
+#include "MPCTable.h"
+
+using std::string;
+
+// Grid: speed (as sent by the simulator), cross track error, orientation
+// error and curvature terms of the reference polynomial.
+const MPCTableAxis kAxes[kTableAxes] = {
+    {0.0, 70.0, 15, 0},       // v
+    {-3.0, 3.0, 13, 0},       // cte
+    {-0.6, 0.6, 13, 0},       // epsi
+    {-0.03, 0.03, 9, 0},      // c2
+    {-0.0015, 0.0015, 7, 0},  // c3
+};
+
+// Grid points solved at once, one vehicle of the fleet each.
+const size_t kBatchSize = 256;
+
+// Backend unless given by --solver.
+const char kDefaultSolver[] = "ilqr";
+
+int main(int argc, char *argv[]) {
+  FleetMPC fleet;
+  fleet.SetSolver(kDefaultSolver);
+  string path;
+  for (int i = 1; i < argc; ++i) {
+    string arg = argv[i];
+    if (arg.compare(0, 9, "--solver=") == 0 &&
+        fleet.SetSolver(arg.substr(9))) {
+      continue;
+    }
+    if (path.empty() && arg.compare(0, 2, "--") != 0) {
+      path = arg;
+      continue;
+    }
+    path.clear();
+    break;
+  }
+  if (path.empty()) {
+    std::cerr << "Usage: " << argv[0]
+              << " <table file> [--solver=<name>], name one of (default "
+              << kDefaultSolver << "):";
+    for (const string &name : SolverBackendNames()) {
+      std::cerr << " " << name;
+    }
+    std::cerr << std::endl;
+    return -1;
+  }
+
+  // Every grid point is solved from scratch; the shifted warm start of
+  // consecutive frames makes no sense between neighbouring points.
+  for (size_t i = 0; i < kBatchSize; ++i) {
+    fleet.Vehicle(fleet.AddVehicle()).use_warm_start = false;
+  }
+  const MPCLayout &layout = fleet.Vehicle(0).Layout();
+  MPCTableHeader header = MakeMPCTableHeader(kAxes, layout.N, layout.dt);
+  const size_t num_points = header.NumPoints();
+  std::cout << "Solving " << num_points << " grid points with "
+            << fleet.SolverName() << std::endl;
+
+  std::vector<float> data(2 * num_points);
+  std::vector<FleetMPC::Request> batch;
+  size_t num_failures = 0;
+  for (size_t start = 0; start < num_points; start += kBatchSize) {
+    batch.clear();
+    for (size_t p = start; p < std::min(num_points, start + kBatchSize);
+         ++p) {
+      // Grid point p, the last axis varying fastest.
+      double q[kTableAxes];
+      size_t rest = p;
+      for (size_t k = kTableAxes; k-- > 0;) {
+        q[k] = kAxes[k].Value(rest % kAxes[k].count);
+        rest /= kAxes[k].count;
+      }
+      FleetMPC::Request request;
+      request.vehicle = p - start;
+      MPCTableProblem(q, request.state, request.coeffs);
+      batch.push_back(request);
+    }
+    std::vector<std::vector<double> > results = fleet.Solve(batch);
+    for (size_t i = 0; i < batch.size(); ++i) {
+      data[2 * (start + i)] = results[i][0];
+      data[2 * (start + i) + 1] = results[i][1];
+      if (!fleet.Vehicle(i).Stats().ok) {
+        ++num_failures;
+      }
+    }
+    std::cout << "\r" << start + batch.size() << " / " << num_points
+              << std::flush;
+  }
+  std::cout << std::endl;
+  if (num_failures > 0) {
+    std::cout << num_failures
+              << " solves failed, their last iterates are in the table"
+              << std::endl;
+  }
+
+  std::ofstream out(path.c_str(), std::ios::binary);
+  out.write(reinterpret_cast<const char *>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char *>(&data[0]),
+            data.size() * sizeof(float));
+  if (!out) {
+    std::cerr << "Failed to write " << path << std::endl;
+    return -1;
+  }
+  std::cout << "Wrote " << path << std::endl;
+  return 0;
+}